@@ -0,0 +1,138 @@
+// Host benchmark: table-driven Crc16 vs. the original bit-by-bit crc16().
+//
+// Built by host/CMakeLists.txt, or directly from the repository root:
+//   g++ -O2 -std=gnu++11 -Isrc host/bench/crc16_bench.cpp src/Crc16.cpp -o crc16_bench
+//   ./crc16_bench [frames.txt]
+//
+// frames.txt is optional: one captured frame per line as hex bytes
+// ("32 00 12 ..."). Without it a set of representative NASA frames is used.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "Crc16.h"
+
+typedef std::vector<uint8_t> Frame;
+
+// Original implementation from NasaProtocol.cpp, kept as the baseline
+static uint16_t crc16Bitwise(const uint8_t* data, size_t length) {
+    uint16_t crc = 0;
+    for (size_t index = 0; index < length; ++index) {
+        crc = crc ^ ((uint16_t)data[index] << 8);
+        for (uint8_t i = 0; i < 8; i++) {
+            if (crc & 0x8000)
+                crc = (crc << 1) ^ 0x1021;
+            else
+                crc <<= 1;
+        }
+    }
+    return crc;
+}
+
+// Frame with `messages` 2-byte variables: start, size, sa, da, command, capacity,
+// messages, crc, end - the same layout Packet::encode produces
+static Frame makeFrame(int messages, uint8_t seed) {
+    Frame frame = {0x32, 0, 0, 0x20, 0x00, 0x00, 0xB0, 0x00, 0xFF, 0xC0, 0x14, seed, (uint8_t)messages};
+    for (int i = 0; i < messages; i++) {
+        frame.push_back(0x42);
+        frame.push_back((uint8_t)(i * 7));
+        frame.push_back((uint8_t)(seed + i));
+        frame.push_back((uint8_t)(i * 13));
+    }
+    size_t size = frame.size() + 3 - 2;
+    frame[1] = (uint8_t)(size >> 8);
+    frame[2] = (uint8_t)(size & 0xFF);
+    uint16_t crc = crc16Bitwise(frame.data() + 3, frame.size() - 3);
+    frame.push_back((uint8_t)(crc >> 8));
+    frame.push_back((uint8_t)(crc & 0xFF));
+    frame.push_back(0x34);
+    return frame;
+}
+
+static std::vector<Frame> loadFrames(const char* path) {
+    std::vector<Frame> frames;
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(1);
+    }
+    char line[8192];
+    while (fgets(line, sizeof(line), file)) {
+        Frame frame;
+        char* cursor = line;
+        char* end = nullptr;
+        for (;;) {
+            unsigned long byte = strtoul(cursor, &end, 16);
+            if (end == cursor) break;
+            frame.push_back((uint8_t)byte);
+            cursor = end;
+        }
+        if (frame.size() >= 16) frames.push_back(frame);
+    }
+    fclose(file);
+    return frames;
+}
+
+template <typename Fn>
+static double nsPerFrame(const std::vector<Frame>& frames, int rounds, Fn fn, uint32_t& sink) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& frame : frames) {
+            sink += fn(frame);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ((double)rounds * frames.size());
+}
+
+int main(int argc, char** argv) {
+    std::vector<Frame> frames;
+    if (argc > 1) {
+        frames = loadFrames(argv[1]);
+    } else {
+        const int sizes[] = {1, 4, 10, 20, 40};
+        for (int i = 0; i < 5; i++) frames.push_back(makeFrame(sizes[i], (uint8_t)(i * 31)));
+    }
+    if (frames.empty()) {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    size_t totalBytes = 0;
+    for (const auto& frame : frames) {
+        size_t length = frame.size() - 6;
+        if (crc16Bitwise(frame.data() + 3, length) != Crc16::compute(frame.data() + 3, length)) {
+            fprintf(stderr, "CRC mismatch between implementations\n");
+            return 1;
+        }
+        totalBytes += frame.size();
+    }
+
+    const int rounds = 200000;
+    uint32_t sink = 0;
+    double bitwise = nsPerFrame(frames, rounds, [](const Frame& f) {
+        return crc16Bitwise(f.data() + 3, f.size() - 6);
+    }, sink);
+    double table = nsPerFrame(frames, rounds, [](const Frame& f) {
+        return Crc16::compute(f.data() + 3, f.size() - 6);
+    }, sink);
+    // Incremental: the cost that remains when the end byte arrives is one compare,
+    // the per-byte work is spread over reception. Measured here as the total.
+    double incremental = nsPerFrame(frames, rounds, [](const Frame& f) {
+        IncrementalCrc16 crc;
+        ByteView view(f);
+        for (size_t available = 1; available <= f.size(); available++) {
+            crc.advance(view.slice(0, available), 3, f.size() - 3);
+        }
+        return crc.value();
+    }, sink);
+
+    printf("frames: %zu, average size: %zu bytes\n", frames.size(), totalBytes / frames.size());
+    printf("bitwise      %8.1f ns/frame\n", bitwise);
+    printf("table        %8.1f ns/frame (%.1fx)\n", table, bitwise / table);
+    printf("incremental  %8.1f ns/frame total, per-byte as received\n", incremental);
+    printf("(checksum %u)\n", sink);
+    return 0;
+}
@@ -0,0 +1,230 @@
+// Host microbenchmarks for the NASA codec, message dispatch and command queue.
+//
+// Built by host/CMakeLists.txt or `pio run -e native`. Reports, per frame (or
+// per command for the queue), wall time, heap allocations and heap bytes
+// allocated, on representative indoor and outdoor notification frames.
+//
+//   ./nasa_bench [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "SamsungACBridge.h"
+#include "Crc16.h"
+
+// Count every heap allocation made while a benchmark runs
+static unsigned long heapAllocations = 0;
+static unsigned long heapBytes = 0;
+
+void* operator new(size_t size) {
+    heapAllocations++;
+    heapBytes += size;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+struct BenchResult {
+    double nsPerOp;
+    double allocationsPerOp;
+    double bytesPerOp;
+};
+
+template <typename Fn>
+static BenchResult measure(int iterations, Fn fn) {
+    fn();  // Warm up: first-use allocations (vector capacity etc.) are not steady state
+
+    unsigned long allocationsBefore = heapAllocations;
+    unsigned long bytesBefore = heapBytes;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    BenchResult result;
+    result.nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    result.allocationsPerOp = (double)(heapAllocations - allocationsBefore) / iterations;
+    result.bytesPerOp = (double)(heapBytes - bytesBefore) / iterations;
+    return result;
+}
+
+static void report(const char* name, const BenchResult& result) {
+    printf("  %-22s %10.1f ns %10.2f allocs %10.1f heap B\n",
+           name, result.nsPerOp, result.allocationsPerOp, result.bytesPerOp);
+}
+
+static void addMessage(Packet& packet, MessageNumber number, int value) {
+    MessageSet message(number);
+    message.value = value;
+    packet.messages.push_back(message);
+}
+
+// Periodic status broadcast of an indoor unit: control state plus sensors
+static std::vector<uint8_t> indoorNotification() {
+    Packet packet = Packet::createPartial(Address::parse("b0.00.ff"), DataType::Notification, 0x21);
+    packet.sa = Address::parse("20.00.00");
+    addMessage(packet, MessageNumber::ENUM_in_operation_power, 1);
+    addMessage(packet, MessageNumber::ENUM_in_operation_mode, 1);
+    addMessage(packet, MessageNumber::ENUM_in_operation_mode_real, 1);
+    addMessage(packet, MessageNumber::ENUM_in_fan_mode, 2);
+    addMessage(packet, MessageNumber::ENUM_in_fan_mode_real, 2);
+    addMessage(packet, MessageNumber::ENUM_in_louver_hl_swing, 0);
+    addMessage(packet, MessageNumber::ENUM_in_louver_lr_swing, 0);
+    addMessage(packet, MessageNumber::ENUM_in_alt_mode, 0);
+    addMessage(packet, MessageNumber::ENUM_in_state_humidity_percent, 48);
+    addMessage(packet, MessageNumber::VAR_in_temp_target_f, 225);
+    addMessage(packet, MessageNumber::VAR_in_temp_room_f, 241);
+    addMessage(packet, MessageNumber::VAR_in_temp_eva_in_f, 128);
+    addMessage(packet, MessageNumber::VAR_in_temp_eva_out_f, 104);
+    addMessage(packet, MessageNumber::VAR_in_capacity_request, 35);
+    addMessage(packet, MessageNumber::VAR_IN_DUST_SENSOR_PM2_5_VALUE, 7);
+    return packet.encode();
+}
+
+// Outdoor unit broadcast: temperatures, power metering, long variables
+static std::vector<uint8_t> outdoorNotification() {
+    Packet packet = Packet::createPartial(Address::parse("b0.ff.ff"), DataType::Notification, 0x42);
+    packet.sa = Address::parse("10.00.00");
+    addMessage(packet, MessageNumber::ENUM_out_operation_odu_mode, 2);
+    addMessage(packet, MessageNumber::ENUM_out_operation_heatcool, 1);
+    addMessage(packet, MessageNumber::ENUM_out_load_4way, 0);
+    addMessage(packet, MessageNumber::VAR_out_sensor_airout, 312);
+    addMessage(packet, MessageNumber::VAR_out_sensor_top1, 655);
+    addMessage(packet, MessageNumber::VAR_OUT_SENSOR_PIPEOUT1, 287);
+    addMessage(packet, MessageNumber::VAR_OUT_SENSOR_CT1, 42);
+    addMessage(packet, MessageNumber::VAR_out_error_code, 0);
+    addMessage(packet, MessageNumber::LVAR_OUT_CONTROL_WATTMETER_1W_1MIN_SUM, 1250);
+    addMessage(packet, MessageNumber::LVAR_OUT_CONTROL_WATTMETER_ALL_UNIT_ACCUM, 1843210);
+    addMessage(packet, MessageNumber::LVAR_NM_OUT_SENSOR_VOLTAGE, 231);
+    return packet.encode();
+}
+
+static void benchFrame(const char* title, const std::vector<uint8_t>& frame, int iterations) {
+    Packet decoded;
+    decoded.decode(ByteView(frame));
+    printf("%s: %zu bytes, %zu messages\n", title, frame.size(), decoded.messages.size());
+
+    ByteView view(frame);
+    volatile uint32_t sink = 0;
+
+    report("crc16", measure(iterations, [&]() {
+        sink += Crc16::compute(view, 3, frame.size() - 6);
+    }));
+
+    Packet packet;
+    report("Packet::decode", measure(iterations, [&]() {
+        sink += (uint32_t)packet.decode(view);
+    }));
+
+    uint8_t buffer[NASA_MAX_FRAME_SIZE];
+    report("Packet::encode", measure(iterations, [&]() {
+        sink += decoded.encode(buffer, sizeof(buffer));
+    }));
+
+    report("processMessageSet", measure(iterations, [&]() {
+        DeviceDelta delta;
+        for (const auto& message : decoded.messages) {
+            processMessageSet(decoded.sa, decoded.da, message, delta);
+        }
+        sink += delta.dirty;
+    }));
+
+    // Bytes in, device state updated: decoder + dispatch + registry + confirmation
+    SamsungACBridge bridge;
+    bridge.begin();
+    NasaDecoder decoder;
+    unsigned long now = 0;
+    report("receive path", measure(iterations, [&]() {
+        decoder.write(frame.data(), frame.size(), now, now * 1000);
+        decoder.process(now, bridge);
+        now++;
+    }));
+    printf("\n");
+    (void)sink;
+}
+
+static void benchCommandQueue(int iterations) {
+    printf("command queue: queue, send, ACK, confirm\n");
+
+    DeviceRegistry devices;
+    CommandQueue queue;
+    queue.setDevices(&devices);
+    NasaProtocol protocol;
+    Address address = Address::parse("20.00.00");
+    bool inserted;
+    DeviceEntry* device = devices.findOrInsert(address, inserted);
+    device->state.power = true;
+    device->state.targetTemperature = 22.5;
+    const uint32_t reported = fieldBit(DeviceField::Power) | fieldBit(DeviceField::TargetTemperature);
+    QueuedRequest request;
+    request.power = true;
+    request.hasPower = true;
+    request.setTargetTemperature(22.5);
+    request.hasTargetTemperature = true;
+
+    // Request and Read frames are written straight into the caller's buffer
+    volatile size_t sink = 0;
+    report("encodeRequest", measure(iterations, [&]() {
+        uint8_t frame[MAX_COMMAND_FRAME_SIZE];
+        sink += protocol.encodeRequest(address, request, frame, sizeof(frame));
+    }));
+    const PollGroup& group = pollGroup(0);
+    report("encodeRead", measure(iterations, [&]() {
+        uint8_t frame[MAX_COMMAND_FRAME_SIZE];
+        sink += protocol.encodeRead(address, group.messages, group.count, frame, sizeof(frame));
+    }));
+    (void)sink;
+
+    // HTTP boundary to queue: parse the address, merge into the unsent command, re-encode
+    SamsungACBridge bridge;
+    bridge.begin();
+    bridge.registerAddress(address);
+    const String target = "20.00.00";
+    ControlRequest control;
+    control.power = true;
+    control.hasPower = true;
+    control.targetTemperature = 22.5;
+    control.hasTargetTemperature = true;
+    report("controlDevice", measure(iterations, [&]() {
+        bridge.controlDevice(target, control);
+    }));
+
+    unsigned long count = 0;
+    report("command cycle", measure(iterations, [&]() {
+        uint8_t frame[MAX_COMMAND_FRAME_SIZE];
+        size_t length = protocol.encodeRequest(address, request, frame, sizeof(frame));
+        queue.addCommand(address, request, frame, length);
+        QueuedCommand* command = queue.getNextCommandToSend();
+        if (command) {
+            uint8_t sequence = queue.markCommandSent(command);
+            NasaProtocol::patchPacketNumber(command->frame, command->frameLength, sequence);
+            queue.handleAck(sequence, millis());
+        }
+        queue.checkStateConfirmation(address, device->state, reported);
+        // The bridge cleans up every 5 s; on the host the clock does not move
+        if (++count % 64 == 0) {
+            hostClockAdvance(20000000);
+            queue.cleanup();
+        }
+    }));
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    if (iterations <= 0) iterations = 200000;
+
+    printf("%d iterations, figures per frame / per command\n\n", iterations);
+    benchFrame("indoor notification", indoorNotification(), iterations);
+    benchFrame("outdoor notification", outdoorNotification(), iterations);
+    benchCommandQueue(iterations);
+    return 0;
+}
@@ -0,0 +1,263 @@
+// End-to-end load test: SamsungACBridge against an emulated NASA bus with one
+// outdoor unit and N indoor units, on the emulated clock.
+//
+// Built by host/CMakeLists.txt:
+//   ./bus_load                       8, 32 and 64 indoor units, 120 s each
+//   ./bus_load --units 16 --seconds 600 --indoor-interval 5000 --command-interval 2000
+//   ./bus_load --loss 10             10% of unicast requests lost, to exercise retries
+//
+// Each unit count also runs back-to-back "all" commands, one issued as soon as
+// the previous has confirmed, more of them than there are group slots.
+//
+// The bridge's own transmissions are delivered to the emulator instantly and
+// do not take bus airtime; everything the units send is paced at 9600 baud.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "SamsungACBridge.h"
+#include "emulator/NasaBusEmulator.h"
+
+struct LoadOptions {
+    int seconds = 120;
+    unsigned long indoorInterval = 6000;
+    unsigned long outdoorInterval = 2000;
+    unsigned long commandInterval = 1000;   // One control request per interval, after discovery
+    unsigned long groupInterval = 20000;    // One "all" request per interval, 0 to disable
+    unsigned lossPercent = 0;               // Unicast requests the units never see
+    uint32_t seed = 1;
+};
+
+static int runLoad(int indoorUnits, const LoadOptions& options) {
+    Serial2.rx.clear();
+    Serial2.tx.clear();
+    hostClockSet(0);
+
+    std::unique_ptr<SamsungACBridge> bridge(new SamsungACBridge());
+    bridge->begin(RS485_RX_PIN, RS485_TX_PIN, RS485_BAUD_RATE);
+    NasaBusEmulator bus(indoorUnits, options.indoorInterval, options.outdoorInterval, options.seed);
+    bus.setRequestLoss(options.lossPercent);
+
+    std::vector<uint8_t> wire;
+    std::vector<uint32_t> tracked;          // Command ids from controlDevice, until they finish
+    unsigned long confirmed = 0, unconfirmed = 0, totalConfirmMs = 0, maxConfirmMs = 0;
+    unsigned long commandsIssued = 0, commandsRejected = 0, commandsMerged = 0, groupCommands = 0, maxBacklog = 0;
+    unsigned long discoveryDone = 2 * options.indoorInterval;
+    unsigned long endMs = (unsigned long)options.seconds * 1000;
+    uint32_t random = options.seed * 2654435761u + 1;
+
+    auto started = std::chrono::steady_clock::now();
+    for (unsigned long ms = 0; ms < endMs; ms++) {
+        hostClockSet(ms * 1000);
+
+        wire.clear();
+        bus.step(ms, wire);
+        Serial2.rx.insert(Serial2.rx.end(), wire.begin(), wire.end());
+        if (bus.backlog() > maxBacklog) maxBacklog = bus.backlog();
+
+        bridge->loop();
+
+        if (!Serial2.tx.empty()) {
+            bus.receive(Serial2.tx.data(), Serial2.tx.size(), ms);
+            Serial2.tx.clear();
+        }
+        
+        // Follow commands by id the way a GET /command client would
+        for (size_t i = 0; i < tracked.size();) {
+            const QueuedCommand* cmd = bridge->getCommand(tracked[i]);
+            if (cmd && !CommandQueue::isFinished(*cmd)) {
+                i++;
+                continue;
+            }
+            if (cmd && cmd->confirmed) {
+                unsigned long latency = cmd->finishedTime - cmd->queuedTime;
+                confirmed++;
+                totalConfirmMs += latency;
+                if (latency > maxConfirmMs) maxConfirmMs = latency;
+            } else {
+                unconfirmed++;
+            }
+            tracked[i] = tracked.back();
+            tracked.pop_back();
+        }
+
+        // Control traffic: random target temperature on a random indoor unit,
+        // stopping a few seconds before the end so the last commands can settle
+        if (indoorUnits > 0 && ms >= discoveryDone && ms + 5000 < endMs && ms % options.commandInterval == 0) {
+            random = random * 1103515245u + 12345u;
+            const EmulatedUnit& unit = bus.unit(1 + (random >> 8) % indoorUnits);
+            ControlRequest request;
+            request.power = true;
+            request.hasPower = true;
+            request.targetTemperature = 18.0f + (float)((random >> 16) % 12);
+            request.hasTargetTemperature = true;
+            request.priority = CommandPriority::Automation;
+            commandsIssued++;
+            ControlResult result;
+            if (!bridge->controlDevice(unit.address.toString(), request, &result)) commandsRejected++;
+            else if (result.merged) commandsMerged++;
+            else tracked.push_back(result.commandId);
+        }
+        
+        // Whole-building action: one broadcast frame for every indoor unit
+        if (indoorUnits > 0 && options.groupInterval > 0 && ms >= discoveryDone && ms + 5000 < endMs &&
+            ms % options.groupInterval == options.groupInterval / 2) {
+            random = random * 1103515245u + 12345u;
+            ControlRequest request;
+            request.power = true;
+            request.hasPower = true;
+            request.targetTemperature = 18.0f + (float)((random >> 16) % 12);
+            request.hasTargetTemperature = true;
+            groupCommands++;
+            ControlResult result;
+            if (!bridge->controlDevice("all", request, &result)) commandsRejected++;
+            else if (!result.merged) tracked.push_back(result.commandId);
+        }
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    // Compare what the bridge believes with what the emulated units are doing
+    int mismatches = 0;
+    for (size_t i = 1; i < bus.unitCount(); i++) {
+        const EmulatedUnit& unit = bus.unit(i);
+        DeviceState state = bridge->getDeviceState(unit.address.toString());
+        if (state.power != unit.power || (int)(state.targetTemperature * 10 + 0.5f) != unit.targetTemperature) {
+            mismatches++;
+        }
+    }
+
+    const RxStats& rx = bridge->getRxStats();
+    const EmulatorStats& emu = bus.getStats();
+    size_t discovered = bridge->getDiscoveredDevices().size();
+    double utilisation = 100.0 * emu.busBytes / ((double)NasaBusEmulator::BYTES_PER_SECOND * options.seconds);
+
+    printf("%3d indoor units, %d s emulated, %.0f ms wall\n", indoorUnits, options.seconds, wallMs);
+    printf("  discovered %zu/%zu devices, %lu frames decoded, %lu decode errors\n",
+           discovered, bus.unitCount(), rx.framesDecoded, rx.decodeErrors);
+    printf("  bus %.0f%% busy, max backlog %lu bytes\n", utilisation, maxBacklog);
+    printf("  commands %lu issued, %lu merged, %lu to all units, %lu rejected, %lu received by units, "
+           "%lu ACKed, %zu still pending\n",
+           commandsIssued, commandsMerged, groupCommands, commandsRejected, emu.requestsReceived, emu.acksSent,
+           bridge->getPendingCommandsCount());
+    for (int i = 0; i < COMMAND_PRIORITY_COUNT; i++) {
+        const QueueClassStats& wait = bridge->getQueueClassStats((CommandPriority)i);
+        if (wait.sent == 0 && wait.expired == 0) continue;
+        printf("  %-11s %lu sent, %lu expired, wait avg %lu ms, max %lu ms\n",
+               commandPriorityToString((CommandPriority)i), wait.sent, wait.expired,
+               wait.totalWaitMs / (wait.sent ? wait.sent : 1), wait.maxWaitMs);
+    }
+    printf("  %lu commands confirmed (avg %lu ms, max %lu ms from queued), %lu finished unconfirmed\n",
+           confirmed, totalConfirmMs / (confirmed ? confirmed : 1), maxConfirmMs, unconfirmed);
+    const TxStats& tx = bridge->getTxStats();
+    printf("  bridge frames %lu sent, %lu deferred, %lu forced, %lu collided (%lu estimated by the bridge)\n",
+           tx.framesSent, tx.deferredSends, tx.forcedSends, emu.collisions, tx.estimatedCollisions);
+    unsigned long firstSends = 0;
+    for (int i = 0; i < COMMAND_PRIORITY_COUNT; i++) firstSends += bridge->getQueueClassStats((CommandPriority)i).sent;
+    const PollStats& poll = bridge->getPollStats();
+    printf("  %lu retransmissions, %lu requests lost by the units\n",
+           tx.framesSent - firstSends - poll.requestsSent, emu.requestsLost);
+    unsigned long rttSum = 0, rttDevices = 0;
+    for (size_t i = 1; i < bus.unitCount(); i++) {
+        LinkTiming link = bridge->getLinkTiming(bus.unit(i).address.toString());
+        if (link.ack.samples() == 0) continue;
+        rttSum += link.ack.smoothed();
+        rttDevices++;
+    }
+    printf("  ACK round trip %lu ms (mean of per-device smoothed, %lu devices, from TX-done)\n",
+           rttSum / (rttDevices ? rttDevices : 1), rttDevices);
+    printf("  polls %lu sent (%lu messages), %lu answered, %lu budget waits, %.1f%% airtime\n",
+           poll.requestsSent, poll.messagesRequested, poll.responses, poll.budgetDeferrals,
+           100.0 * poll.airtimeMicros / (options.seconds * 1e6));
+    printf("  state mismatches after settling: %d\n\n", mismatches);
+
+    return (discovered == bus.unitCount() && mismatches == 0) ? 0 : 1;
+}
+
+// Group commands must not keep their group slot once finished: each of these
+// is issued the moment the previous one confirmed and must be accepted
+static int runGroupBurst(int indoorUnits, const LoadOptions& options) {
+    static const int BURST_COMMANDS = GROUP_POOL_SIZE + 2;
+    
+    Serial2.rx.clear();
+    Serial2.tx.clear();
+    hostClockSet(0);
+
+    std::unique_ptr<SamsungACBridge> bridge(new SamsungACBridge());
+    bridge->begin(RS485_RX_PIN, RS485_TX_PIN, RS485_BAUD_RATE);
+    NasaBusEmulator bus(indoorUnits, options.indoorInterval, options.outdoorInterval, options.seed);
+
+    std::vector<uint8_t> wire;
+    int issued = 0, finished = 0, confirmed = 0, rejected = 0;
+    uint32_t current = 0;
+    unsigned long discoveryDone = 2 * options.indoorInterval;
+    unsigned long endMs = discoveryDone + BURST_COMMANDS * 30000UL;
+
+    for (unsigned long ms = 0; ms < endMs && finished < BURST_COMMANDS && rejected == 0; ms++) {
+        hostClockSet(ms * 1000);
+
+        wire.clear();
+        bus.step(ms, wire);
+        Serial2.rx.insert(Serial2.rx.end(), wire.begin(), wire.end());
+        bridge->loop();
+        if (!Serial2.tx.empty()) {
+            bus.receive(Serial2.tx.data(), Serial2.tx.size(), ms);
+            Serial2.tx.clear();
+        }
+        if (ms < discoveryDone) continue;
+
+        if (current) {
+            const QueuedCommand* cmd = bridge->getCommand(current);
+            if (cmd && !CommandQueue::isFinished(*cmd)) continue;
+            if (cmd && cmd->confirmed) confirmed++;
+            finished++;
+            current = 0;
+        }
+        if (issued == BURST_COMMANDS) continue;
+
+        ControlRequest request;
+        request.power = true;
+        request.hasPower = true;
+        request.targetTemperature = 18.0f + issued;
+        request.hasTargetTemperature = true;
+        ControlResult result;
+        issued++;
+        if (bridge->controlDevice("all", request, &result)) current = result.commandId;
+        else rejected++;
+    }
+
+    printf("%3d indoor units, back-to-back group commands: %d issued, %d confirmed, %d rejected\n\n",
+           indoorUnits, issued, confirmed, rejected);
+    return (rejected == 0 && confirmed == BURST_COMMANDS) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    std::vector<int> unitCounts;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--units") == 0) unitCounts.push_back(atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--seconds") == 0) options.seconds = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--indoor-interval") == 0) options.indoorInterval = strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--outdoor-interval") == 0) options.outdoorInterval = strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--command-interval") == 0) options.commandInterval = strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--group-interval") == 0) options.groupInterval = strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--loss") == 0) options.lossPercent = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) options.seed = strtoul(argv[i + 1], nullptr, 10);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (unitCounts.empty()) unitCounts = {8, 32, 64};
+    if (options.commandInterval == 0) options.commandInterval = 1000;
+
+    int failures = 0;
+    for (int units : unitCounts) {
+        failures += runLoad(units, options);
+        if (units > 0) failures += runGroupBurst(units, options);
+    }
+    return failures ? 1 : 0;
+}
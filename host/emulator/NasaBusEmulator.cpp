@@ -0,0 +1,233 @@
+#include "NasaBusEmulator.h"
+
+static void addMessage(Packet& packet, MessageNumber number, long value) {
+    MessageSet message(number);
+    message.value = (int32_t)value;
+    packet.messages.push_back(message);
+}
+
+NasaBusEmulator::NasaBusEmulator(int indoorUnits, unsigned long indoorIntervalMs,
+                                 unsigned long outdoorIntervalMs, uint32_t seed)
+    : indoorInterval(indoorIntervalMs), outdoorInterval(outdoorIntervalMs), random(seed ? seed : 1) {
+    EmulatedUnit outdoor;
+    outdoor.address = Address::unpack(0x100000);
+    outdoor.outdoor = true;
+    outdoor.nextNotification = jitter(outdoorInterval);
+    units.push_back(outdoor);
+
+    for (int i = 0; i < indoorUnits; i++) {
+        EmulatedUnit indoor;
+        indoor.address = Address::unpack(0x200000 | (uint32_t)i);
+        indoor.roomTemperature = 220 + (int)(nextRandom() % 60);
+        indoor.nextNotification = jitter(indoorInterval);
+        units.push_back(indoor);
+    }
+}
+
+uint32_t NasaBusEmulator::nextRandom() {
+    // xorshift32 - deterministic for a given seed
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return random;
+}
+
+unsigned long NasaBusEmulator::jitter(unsigned long interval) {
+    // Spread units over the interval so they do not all talk at once
+    return interval / 2 + nextRandom() % (interval + 1);
+}
+
+EmulatedUnit* NasaBusEmulator::findUnit(const Address& address) {
+    for (auto& unit : units) {
+        if (unit.address == address) return &unit;
+    }
+    return nullptr;
+}
+
+void NasaBusEmulator::queuePacket(const Packet& packet) {
+    uint8_t frame[NASA_MAX_FRAME_SIZE];
+    size_t length = packet.encode(frame, sizeof(frame));
+    txQueue.insert(txQueue.end(), frame, frame + length);
+    frameLengths.push_back(length);
+}
+
+void NasaBusEmulator::notify(EmulatedUnit& unit) {
+    Packet packet = Packet::createPartial(Address::unpack(unit.outdoor ? 0xB0FFFF : 0xB000FF),
+                                          DataType::Notification, packetNumber++);
+    packet.sa = unit.address;
+
+    if (unit.outdoor) {
+        addMessage(packet, MessageNumber::ENUM_out_operation_odu_mode, 2);
+        addMessage(packet, MessageNumber::VAR_out_sensor_airout, unit.outdoorTemperature);
+        addMessage(packet, MessageNumber::VAR_OUT_SENSOR_CT1, 42);
+        addMessage(packet, MessageNumber::VAR_out_error_code, 0);
+        addMessage(packet, MessageNumber::LVAR_OUT_CONTROL_WATTMETER_1W_1MIN_SUM, 1250);
+        addMessage(packet, MessageNumber::LVAR_OUT_CONTROL_WATTMETER_ALL_UNIT_ACCUM, unit.cumulativeEnergy);
+        addMessage(packet, MessageNumber::LVAR_NM_OUT_SENSOR_VOLTAGE, 231);
+    } else {
+        addMessage(packet, MessageNumber::ENUM_in_operation_power, unit.power ? 1 : 0);
+        addMessage(packet, MessageNumber::ENUM_in_operation_mode, unit.mode);
+        addMessage(packet, MessageNumber::ENUM_in_fan_mode, unit.fanMode);
+        addMessage(packet, MessageNumber::ENUM_in_louver_hl_swing, unit.swingVertical ? 1 : 0);
+        addMessage(packet, MessageNumber::ENUM_in_louver_lr_swing, unit.swingHorizontal ? 1 : 0);
+        addMessage(packet, MessageNumber::ENUM_in_alt_mode, unit.preset);
+        addMessage(packet, MessageNumber::VAR_in_temp_target_f, unit.targetTemperature);
+        addMessage(packet, MessageNumber::VAR_in_temp_room_f, unit.roomTemperature);
+        addMessage(packet, MessageNumber::VAR_in_temp_eva_in_f, unit.roomTemperature - 90);
+        addMessage(packet, MessageNumber::VAR_in_temp_eva_out_f, unit.roomTemperature - 120);
+    }
+
+    queuePacket(packet);
+    stats.notificationsSent++;
+}
+
+void NasaBusEmulator::simulate(EmulatedUnit& unit) {
+    if (unit.outdoor) {
+        unit.outdoorTemperature += (int)(nextRandom() % 3) - 1;
+        unit.cumulativeEnergy += nextRandom() % 5;
+        return;
+    }
+    // Room temperature creeps towards the target while running
+    if (unit.power && unit.roomTemperature != unit.targetTemperature) {
+        unit.roomTemperature += unit.roomTemperature < unit.targetTemperature ? 1 : -1;
+    }
+}
+
+void NasaBusEmulator::receive(const uint8_t* data, size_t length, unsigned long nowMs) {
+    now = nowMs;
+    
+    // Both frames are garbled; the units never see the bridge's request
+    if (frameRemaining > 0) {
+        stats.collisions++;
+        return;
+    }
+    busyUntil = nowMs + (length * 1000 + BYTES_PER_SECOND - 1) / BYTES_PER_SECOND;
+    decoder.write(data, length, nowMs, nowMs * 1000);
+    decoder.process(nowMs, *this);
+}
+
+void NasaBusEmulator::apply(EmulatedUnit& unit, const Packet& packet) {
+    for (const auto& message : packet.messages) {
+        switch (message.messageNumber) {
+            case MessageNumber::ENUM_in_operation_power: unit.power = message.value != 0; break;
+            case MessageNumber::ENUM_in_operation_mode: unit.mode = message.value; break;
+            case MessageNumber::VAR_in_temp_target_f: unit.targetTemperature = message.value; break;
+            case MessageNumber::ENUM_in_fan_mode: unit.fanMode = message.value; break;
+            case MessageNumber::ENUM_in_louver_hl_swing: unit.swingVertical = message.value != 0; break;
+            case MessageNumber::ENUM_in_louver_lr_swing: unit.swingHorizontal = message.value != 0; break;
+            case MessageNumber::ENUM_in_alt_mode: unit.preset = message.value; break;
+            default: continue;
+        }
+        stats.stateChanges++;
+    }
+    
+    // Real units report the new state within a few hundred ms
+    unsigned long soon = now + 100 + nextRandom() % 300;
+    if (unit.nextNotification > soon) unit.nextNotification = soon;
+}
+
+long NasaBusEmulator::readValue(const EmulatedUnit& unit, MessageNumber number) {
+    switch (number) {
+        case MessageNumber::ENUM_in_state_humidity_percent: return 40 + nextRandom() % 20;
+        case MessageNumber::VAR_IN_DUST_SENSOR_PM10_0_VALUE: return 10 + nextRandom() % 30;
+        case MessageNumber::VAR_IN_DUST_SENSOR_PM2_5_VALUE: return 5 + nextRandom() % 20;
+        case MessageNumber::VAR_IN_DUST_SENSOR_PM1_0_VALUE: return 2 + nextRandom() % 10;
+        case MessageNumber::VAR_IN_FSV_3021: return 450;
+        case MessageNumber::VAR_IN_FSV_3022: return 20;
+        case MessageNumber::VAR_IN_FSV_3023: return 30;
+        case MessageNumber::VAR_in_capacity_request: return unit.power ? 24 : 0;
+        case MessageNumber::VAR_out_control_order_cfreq_comp2:
+        case MessageNumber::VAR_out_control_target_cfreq_comp2: return 40 + nextRandom() % 40;
+        case MessageNumber::VAR_out_sensor_top1: return 650 + nextRandom() % 100;
+        case MessageNumber::VAR_OUT_PHASE_CURRENT: return 30 + nextRandom() % 20;
+        case MessageNumber::ENUM_out_operation_heatcool: return 1;
+        case MessageNumber::VAR_OUT_PROJECT_CODE: return 12345;
+        case MessageNumber::VAR_OUT_PRODUCT_OPTION_CAPA: return 140;
+        default: return 0;
+    }
+}
+
+void NasaBusEmulator::respond(EmulatedUnit& unit, const Packet& read) {
+    Packet response = Packet::createPartial(read.sa, DataType::Response, read.command.packetNumber);
+    response.sa = unit.address;
+    for (const auto& message : read.messages) {
+        addMessage(response, message.messageNumber, readValue(unit, message.messageNumber));
+    }
+    queuePacket(response);
+    stats.readsReceived++;
+}
+
+void NasaBusEmulator::onPacket(const Packet& packet) {
+    if (packet.command.dataType == DataType::Read) {
+        EmulatedUnit* unit = findUnit(packet.da);
+        if (unit) respond(*unit, packet);
+        return;
+    }
+    if (packet.command.dataType != DataType::Request && packet.command.dataType != DataType::Write) return;
+
+    // Broadcast: every indoor unit of the channel (or all channels) applies it, nobody ACKs
+    if (packet.da.isBroadcast()) {
+        stats.broadcastsReceived++;
+        for (auto& unit : units) {
+            if (unit.outdoor) continue;
+            if (packet.da.channel != GROUP_ANY && unit.address.channel != packet.da.channel) continue;
+            apply(unit, packet);
+        }
+        return;
+    }
+
+    EmulatedUnit* unit = findUnit(packet.da);
+    if (!unit || unit->outdoor) return;
+    if (requestLossPercent && nextRandom() % 100 < requestLossPercent) {
+        stats.requestsLost++;
+        return;
+    }
+    stats.requestsReceived++;
+
+    // ACK back to the requester with the same packet number
+    Packet ack = Packet::createPartial(packet.sa, DataType::Ack, packet.command.packetNumber);
+    ack.sa = unit->address;
+    queuePacket(ack);
+    stats.acksSent++;
+
+    apply(*unit, packet);
+}
+
+void NasaBusEmulator::step(unsigned long nowMs, std::vector<uint8_t>& wire) {
+    unsigned long elapsed = nowMs - now;
+    now = nowMs;
+
+    for (auto& unit : units) {
+        if ((long)(nowMs - unit.nextNotification) < 0) continue;
+        // Units hold their broadcast while the bus is saturated
+        if (txQueue.size() > MAX_BACKLOG_BYTES) break;
+        simulate(unit);
+        notify(unit);
+        unit.nextNotification = nowMs + jitter(unit.outdoor ? outdoorInterval : indoorInterval);
+    }
+
+    // Drain the transmit queue at wire speed, leaving a gap after each frame
+    bool lineFree = (long)(nowMs - busyUntil) >= 0 && (long)(nowMs - idleUntil) >= 0;
+    if (frameRemaining == 0 && (frameLengths.empty() || !lineFree)) {
+        wireMicros = 0;
+        return;
+    }
+    wireMicros += elapsed * 1000;
+    const unsigned long microsPerByte = 1000000 / BYTES_PER_SECOND;
+    while (wireMicros >= microsPerByte) {
+        if (frameRemaining == 0) {
+            if (frameLengths.empty()) break;
+            frameRemaining = frameLengths.front();
+            frameLengths.pop_front();
+        }
+        wire.push_back(txQueue.front());
+        txQueue.pop_front();
+        wireMicros -= microsPerByte;
+        stats.busBytes++;
+        if (--frameRemaining == 0) {
+            idleUntil = nowMs + MIN_FRAME_GAP_MS + nextRandom() % FRAME_GAP_JITTER_MS;
+            wireMicros = 0;
+            break;
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include "NasaDecoder.h"
+#include "NasaProtocol.h"
+
+// One simulated unit on the bus
+struct EmulatedUnit {
+    Address address;
+    bool outdoor = false;
+    unsigned long nextNotification = 0;     // Emulated ms
+
+    // Indoor control state, as the bridge would set it
+    bool power = false;
+    int mode = 1;                           // NASA operation mode (Cool)
+    int targetTemperature = 240;            // Tenths of a degree
+    int fanMode = 0;                        // NASA fan mode (Auto)
+    bool swingVertical = false;
+    bool swingHorizontal = false;
+    int preset = 0;
+
+    // Sensors that drift over time
+    int roomTemperature = 255;
+    int outdoorTemperature = 310;
+    long cumulativeEnergy = 1500000;
+};
+
+struct EmulatorStats {
+    unsigned long notificationsSent = 0;
+    unsigned long requestsReceived = 0;
+    unsigned long broadcastsReceived = 0;   // Group requests, applied by every matching unit
+    unsigned long acksSent = 0;
+    unsigned long stateChanges = 0;
+    unsigned long busBytes = 0;             // Bytes put on the bus by the emulated units
+    unsigned long collisions = 0;           // Bridge frames sent while a unit was mid-frame
+    unsigned long requestsLost = 0;         // Dropped by the configured request loss
+    unsigned long readsReceived = 0;        // Read requests answered with a Response
+};
+
+// Emulates a NASA bus with one outdoor unit (10.00.00) and N indoor units
+// (20.00.00 ...), framed with Packet::encode. Units broadcast notifications
+// on a jittered cadence, ACK requests addressed to them from the JIGTester
+// and apply the requested state, then report it in an immediate notification.
+// Requests to a broadcast address are applied by every matching indoor unit
+// without an ACK. Read requests are answered with a Response carrying a
+// plausible value for every requested message.
+// Bus airtime is modelled at 9600 baud 8E1: bytes leave the transmit queue at
+// wire speed with a short gap after every frame, so a saturated bus shows up as
+// growing latency. A bridge frame occupies the line for its airtime; one that
+// starts while a unit is mid-frame collides and is lost. A share of unicast
+// requests can be dropped on purpose to exercise the bridge's retries.
+class NasaBusEmulator : public PacketHandler {
+public:
+    NasaBusEmulator(int indoorUnits, unsigned long indoorIntervalMs, unsigned long outdoorIntervalMs,
+                    uint32_t seed = 1);
+
+    // Bytes transmitted by the bridge
+    void receive(const uint8_t* data, size_t length, unsigned long nowMs);
+
+    // Advance to nowMs; appends the bytes that crossed the wire since the last step
+    void step(unsigned long nowMs, std::vector<uint8_t>& wire);
+
+    size_t unitCount() const { return units.size(); }
+    const EmulatedUnit& unit(size_t i) const { return units[i]; }
+    const EmulatorStats& getStats() const { return stats; }
+    size_t backlog() const { return txQueue.size(); }   // Bytes waiting for the wire
+    
+    // Lose this percentage of unicast requests (never applied, never ACKed)
+    void setRequestLoss(unsigned percent) { requestLossPercent = percent; }
+
+    // PacketHandler: frames the bridge sent
+    void onPacket(const Packet& packet) override;
+
+    static const unsigned long BYTES_PER_SECOND = 9600 / 11;   // 8 data bits, parity, start, stop
+    static const size_t MAX_BACKLOG_BYTES = BYTES_PER_SECOND;   // One second of airtime
+    static const unsigned long MIN_FRAME_GAP_MS = 3;              // Line turnaround between frames
+    static const unsigned long FRAME_GAP_JITTER_MS = 12;
+
+private:
+    std::vector<EmulatedUnit> units;
+    unsigned long indoorInterval;
+    unsigned long outdoorInterval;
+    uint32_t random;
+    unsigned long now = 0;
+    unsigned long wireMicros = 0;           // Airtime credit carried between steps
+    std::deque<uint8_t> txQueue;
+    std::deque<size_t> frameLengths;        // Frames in txQueue not yet started
+    size_t frameRemaining = 0;              // Bytes left of the frame on the wire
+    unsigned long idleUntil = 0;            // End of the gap after the last unit frame
+    unsigned long busyUntil = 0;            // End of the bridge frame on the wire
+    NasaDecoder decoder;
+    EmulatorStats stats;
+    uint8_t packetNumber = 0;
+    unsigned requestLossPercent = 0;
+
+    uint32_t nextRandom();
+    unsigned long jitter(unsigned long interval);
+    EmulatedUnit* findUnit(const Address& address);
+    void queuePacket(const Packet& packet);
+    void notify(EmulatedUnit& unit);
+    void simulate(EmulatedUnit& unit);
+    void apply(EmulatedUnit& unit, const Packet& packet);
+    void respond(EmulatedUnit& unit, const Packet& read);
+    long readValue(const EmulatedUnit& unit, MessageNumber number);
+};
@@ -0,0 +1,170 @@
+// Linux gateway: runs the bridge core on a USB-RS485 dongle instead of the
+// ESP32 UART, on the system clock.
+//
+// Built by host/CMakeLists.txt:
+//   ./nasa_daemon --device /dev/ttyUSB0 [--baud 9600] [--status-interval 60]
+//   ./nasa_daemon --pty        create a pseudo terminal and print the path
+//                              the bus side (socat, a simulator) should open
+//
+// Every status interval the device table is printed to stdout. Control
+// requests are read from stdin, one per line:
+//   20.00.01 power=on temp=22.5
+//   all power=off
+// and answered with the command id, then its outcome once it finishes.
+// SIGINT / SIGTERM print the bus counters and exit.
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "SamsungACBridge.h"
+#include "transport/PosixTtyTransport.h"
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) { stopRequested = 1; }
+
+static void printDevices(SamsungACBridge& bridge) {
+    auto devices = bridge.getDiscoveredDevices();
+    printf("[%lu s] %zu devices\n", millis() / 1000, devices.size());
+    for (const auto& address : devices) {
+        DeviceState state = bridge.getDeviceState(address);
+        printf("  %s %-8s %-7s power=%d mode=%d target=%.1f room=%.1f outdoor=%.1f\n", address.c_str(),
+               bridge.getDeviceType(address).c_str(), bridge.isDeviceOnline(address) ? "online" : "offline",
+               state.power, (int)state.mode, state.targetTemperature, state.roomTemperature,
+               state.outdoorTemperature);
+    }
+    fflush(stdout);
+}
+
+// "<address> key=value ...": power=on|off, temp=<celsius>
+static void handleLine(SamsungACBridge& bridge, char* line, std::vector<uint32_t>& tracked) {
+    char* address = strtok(line, " \t\r\n");
+    if (!address) return;
+    
+    ControlRequest request;
+    while (char* field = strtok(nullptr, " \t\r\n")) {
+        char* value = strchr(field, '=');
+        if (!value) continue;
+        *value++ = '\0';
+        if (strcmp(field, "power") == 0) {
+            request.power = strcmp(value, "on") == 0 || strcmp(value, "1") == 0;
+            request.hasPower = true;
+        } else if (strcmp(field, "temp") == 0) {
+            request.targetTemperature = (float)atof(value);
+            request.hasTargetTemperature = true;
+        } else {
+            printf("unknown field %s\n", field);
+        }
+    }
+    
+    ControlResult result;
+    if (!bridge.controlDevice(address, request, &result)) {
+        printf("%s: %s\n", address, result.queueFull ? "queue full" : "rejected");
+    } else {
+        printf("%s: command %u%s\n", address, (unsigned)result.commandId, result.merged ? " (merged)" : "");
+        if (!result.merged) tracked.push_back(result.commandId);
+    }
+    fflush(stdout);
+}
+
+static void reportFinished(SamsungACBridge& bridge, std::vector<uint32_t>& tracked) {
+    for (size_t i = 0; i < tracked.size();) {
+        const QueuedCommand* cmd = bridge.getCommand(tracked[i]);
+        if (cmd && !CommandQueue::isFinished(*cmd)) {
+            i++;
+            continue;
+        }
+        if (cmd) {
+            printf("command %u %s after %lu ms\n", (unsigned)cmd->id, commandStateToString(cmd->state),
+                   cmd->finishedTime - cmd->queuedTime);
+        } else {
+            printf("command %u expired\n", (unsigned)tracked[i]);
+        }
+        fflush(stdout);
+        tracked[i] = tracked.back();
+        tracked.pop_back();
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* device = nullptr;
+    bool pty = false;
+    unsigned long baudRate = RS485_BAUD_RATE;
+    unsigned long statusInterval = 60;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--pty") == 0) pty = true;
+        else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) device = argv[++i];
+        else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) baudRate = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--status-interval") == 0 && i + 1 < argc) statusInterval = strtoul(argv[++i], nullptr, 10);
+        else {
+            fprintf(stderr, "usage: %s --device /dev/ttyUSB0 | --pty [--baud N] [--status-interval S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!device && !pty) {
+        fprintf(stderr, "%s: --device or --pty required\n", argv[0]);
+        return 2;
+    }
+    
+    hostClockUseSystem();
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    
+    PosixTtyTransport transport(device);
+    SamsungACBridge bridge;
+    if (!bridge.begin(transport, baudRate)) return 1;
+    if (pty) printf("bus side: %s\n", transport.peerPath());
+    printf("bridge running on %s at %lu baud\n", pty ? transport.peerPath() : device, baudRate);
+    fflush(stdout);
+    
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+    std::string input;
+    bool stdinOpen = true;
+    std::vector<uint32_t> tracked;
+    unsigned long lastStatus = millis();
+    
+    while (!stopRequested) {
+        bridge.loop();
+        reportFinished(bridge, tracked);
+        
+        if (statusInterval && millis() - lastStatus >= statusInterval * 1000) {
+            printDevices(bridge);
+            lastStatus = millis();
+        }
+        
+        // Sleep until the bus or stdin has something, at most one millisecond
+        // so retries, polls and the transmit scheduler keep their timing
+        struct pollfd fds[2] = {{transport.descriptor(), POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        poll(fds, stdinOpen ? 2 : 1, 1);
+        
+        if (stdinOpen && (fds[1].revents & (POLLIN | POLLHUP))) {
+            char buffer[256];
+            ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (count <= 0) {
+                stdinOpen = count < 0;
+                continue;
+            }
+            input.append(buffer, count);
+            size_t end;
+            while ((end = input.find('\n')) != std::string::npos) {
+                std::string line = input.substr(0, end);
+                input.erase(0, end + 1);
+                handleLine(bridge, &line[0], tracked);
+            }
+        }
+    }
+    
+    const RxStats& rx = bridge.getRxStats();
+    const TxStats& tx = bridge.getTxStats();
+    printDevices(bridge);
+    printf("%lu bytes, %lu frames decoded, %lu decode errors; %lu frames sent, %lu estimated collisions\n",
+           rx.bytesReceived, rx.framesDecoded, rx.decodeErrors, tx.framesSent, tx.estimatedCollisions);
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Host replay driver: feeds a bus capture (GET /capture or the TCP capture
+// stream) through the real SamsungACBridge / NasaDecoder / NasaProtocol code
+// as fast as the host can go, then prints what the bridge ended up with.
+//
+// Built by host/CMakeLists.txt, or directly from the repository root:
+//   g++ -O2 -std=gnu++11 -DDEBUG_ENABLED=0 -Ihost/shim -Isrc -o nasa_replay
+//       host/nasa_replay.cpp host/shim/ArduinoHost.cpp $(ls src/*.cpp | grep -v main.cpp)
+//   ./nasa_replay capture.bin [--repeat N]
+//
+// Received spans are replayed with their original timestamps, so frame-gap and
+// transmission timeouts behave as they did on the bus. Frames the bridge sent
+// (CAPTURE_FLAG_TX) are skipped; the bridge's own transmissions during replay
+// are discarded.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "SamsungACBridge.h"
+
+struct CaptureRecord {
+    uint32_t timestamp;
+    uint8_t result;
+    uint8_t flags;
+    std::vector<uint8_t> bytes;
+};
+
+static bool loadCapture(const char* path, std::vector<CaptureRecord>& records) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    uint8_t header[CAPTURE_FILE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, "NASACAP", 7) != 0 || header[7] != CAPTURE_FORMAT_VERSION) {
+        fprintf(stderr, "%s is not a version %d NASA capture\n", path, CAPTURE_FORMAT_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    uint8_t recordHeader[CAPTURE_RECORD_HEADER_SIZE];
+    while (fread(recordHeader, 1, sizeof(recordHeader), file) == sizeof(recordHeader)) {
+        CaptureRecord record;
+        record.timestamp = recordHeader[0] | (recordHeader[1] << 8) | (recordHeader[2] << 16) |
+                           ((uint32_t)recordHeader[3] << 24);
+        size_t length = recordHeader[4] | (recordHeader[5] << 8);
+        record.result = recordHeader[6];
+        record.flags = recordHeader[7];
+        record.bytes.resize(length);
+        if (fread(record.bytes.data(), 1, length, file) != length) {
+            fprintf(stderr, "warning: capture ends mid-record\n");
+            break;
+        }
+        records.push_back(record);
+    }
+
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.bin [--repeat N]\n", argv[0]);
+        return 1;
+    }
+    int repeat = 1;
+    if (argc >= 4 && strcmp(argv[2], "--repeat") == 0) repeat = atoi(argv[3]);
+
+    std::vector<CaptureRecord> records;
+    if (!loadCapture(argv[1], records)) return 1;
+
+    size_t rxRecords = 0, rxBytes = 0, capturedFrames = 0;
+    for (const auto& record : records) {
+        if (record.flags & CAPTURE_FLAG_TX) continue;
+        rxRecords++;
+        rxBytes += record.bytes.size();
+        if (record.result == (uint8_t)DecodeResult::Ok) capturedFrames++;
+    }
+    printf("capture: %zu records (%zu rx), %zu rx bytes, %zu frames decoded on device\n",
+           records.size(), rxRecords, rxBytes, capturedFrames);
+
+    SamsungACBridge bridge;
+    bridge.begin(RS485_RX_PIN, RS485_TX_PIN, RS485_BAUD_RATE);
+
+    // Timestamps restart on every pass so the replay never runs backwards
+    unsigned long timeBase = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < repeat; pass++) {
+        uint32_t first = records.empty() ? 0 : records.front().timestamp;
+        uint32_t last = first;
+        for (const auto& record : records) {
+            if (record.flags & CAPTURE_FLAG_TX) continue;
+            last = record.timestamp;
+            hostClockSet(timeBase + (uint32_t)(record.timestamp - first));
+            Serial2.rx.insert(Serial2.rx.end(), record.bytes.begin(), record.bytes.end());
+            while (!Serial2.rx.empty()) {
+                bridge.loop();
+            }
+            // A record is at most one frame; one more pass decodes its tail
+            bridge.loop();
+            Serial2.tx.clear();
+        }
+        timeBase += (uint32_t)(last - first) + 1000000;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+
+    const RxStats& stats = bridge.getRxStats();
+    printf("replay: %d pass(es), %lu frames decoded, %lu decode errors, %lu resyncs\n",
+           repeat, stats.framesDecoded, stats.decodeErrors, stats.resyncEvents);
+    if (stats.framesDecoded > 0 && seconds > 0) {
+        printf("speed: %.0f frames/s, %.0f ns/frame, %.1f MB/s\n",
+               stats.framesDecoded / seconds, seconds * 1e9 / stats.framesDecoded,
+               stats.bytesReceived / seconds / 1e6);
+    }
+    for (int i = 1; i < DECODE_RESULT_COUNT; i++) {
+        if (stats.bytesDiscarded[i]) {
+            printf("discarded %s: %lu bytes\n", decodeResultToString((DecodeResult)i), stats.bytesDiscarded[i]);
+        }
+    }
+
+    auto devices = bridge.getDiscoveredDevices();
+    printf("devices: %zu\n", devices.size());
+    for (const auto& address : devices) {
+        DeviceState state = bridge.getDeviceState(address);
+        printf("  %s %-11s power=%d mode=%d target=%.1f room=%.1f sensors=%zu\n",
+               address.c_str(), bridge.getDeviceType(address).c_str(), state.power, (int)state.mode,
+               state.targetTemperature, state.roomTemperature, state.customSensors.size());
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Loopback rig: the bridge on one end of a pseudo terminal through
+// PosixTtyTransport, NasaBusEmulator on the other, on the system clock. Every
+// byte crosses the kernel tty layer, as it would with a USB-RS485 dongle.
+//
+// Built by host/CMakeLists.txt:
+//   ./pty_loopback [--units 8] [--seconds 30]
+//
+// Fails if a device is not discovered, a command does not confirm or the
+// bridge's view disagrees with the units at the end.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "SamsungACBridge.h"
+#include "emulator/NasaBusEmulator.h"
+#include "transport/PosixTtyTransport.h"
+
+int main(int argc, char** argv) {
+    int indoorUnits = 8;
+    int seconds = 30;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--units") == 0) indoorUnits = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seconds") == 0) seconds = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    
+    hostClockUseSystem();
+    const unsigned long indoorInterval = 6000;   // As bus_load
+    
+    // The emulator owns the pty; the bridge opens it by path like any dongle
+    PosixTtyTransport busSide;
+    if (!busSide.begin(9600)) return 1;
+    PosixTtyTransport dongle(busSide.peerPath());
+    SamsungACBridge bridge;
+    if (!bridge.begin(dongle, 9600)) return 1;
+    
+    NasaBusEmulator bus(indoorUnits, indoorInterval, 2000);
+    std::vector<uint8_t> wire;
+    std::vector<uint8_t> pending;       // Bus traffic the pty did not take yet
+    std::vector<uint32_t> tracked;
+    unsigned long confirmed = 0, unconfirmed = 0, issued = 0;
+    uint32_t random = 1;
+    uint8_t buffer[256];
+    
+    unsigned long start = millis();
+    unsigned long discoveryDone = start + 2 * indoorInterval;
+    unsigned long commandsEnd = start + (unsigned long)seconds * 1000 - 5000;
+    unsigned long end = start + (unsigned long)seconds * 1000;
+    unsigned long nextCommand = discoveryDone;
+    
+    for (unsigned long now = start; (long)(now - end) < 0; now = millis()) {
+        wire.clear();
+        bus.step(now, wire);
+        if (!wire.empty()) pending.insert(pending.end(), wire.begin(), wire.end());
+        if (!pending.empty()) pending.erase(pending.begin(), pending.begin() + busSide.write(pending.data(), pending.size()));
+        
+        bridge.loop();
+        
+        size_t count;
+        while ((count = busSide.read(buffer, sizeof(buffer))) > 0) bus.receive(buffer, count, millis());
+        
+        for (size_t i = 0; i < tracked.size();) {
+            const QueuedCommand* cmd = bridge.getCommand(tracked[i]);
+            if (cmd && !CommandQueue::isFinished(*cmd)) {
+                i++;
+                continue;
+            }
+            if (cmd && cmd->confirmed) confirmed++;
+            else unconfirmed++;
+            tracked[i] = tracked.back();
+            tracked.pop_back();
+        }
+        
+        if (indoorUnits > 0 && (long)(now - nextCommand) >= 0 && (long)(now - commandsEnd) < 0) {
+            random = random * 1103515245u + 12345u;
+            ControlRequest request;
+            request.power = true;
+            request.hasPower = true;
+            request.targetTemperature = 18.0f + (float)((random >> 16) % 12);
+            request.hasTargetTemperature = true;
+            ControlResult result;
+            const EmulatedUnit& unit = bus.unit(1 + (random >> 8) % indoorUnits);
+            if (bridge.controlDevice(unit.address.toString(), request, &result) && !result.merged) {
+                tracked.push_back(result.commandId);
+            }
+            issued++;
+            nextCommand = now + 1000;
+        }
+        
+        dongle.waitReadable(1);
+    }
+    
+    int mismatches = 0;
+    for (size_t i = 1; i < bus.unitCount(); i++) {
+        const EmulatedUnit& unit = bus.unit(i);
+        DeviceState state = bridge.getDeviceState(unit.address.toString());
+        if (state.power != unit.power || (int)(state.targetTemperature * 10 + 0.5f) != unit.targetTemperature) {
+            mismatches++;
+        }
+    }
+    
+    const RxStats& rx = bridge.getRxStats();
+    const EmulatorStats& emu = bus.getStats();
+    size_t discovered = bridge.getDiscoveredDevices().size();
+    printf("%d indoor units over %s, %d s\n", indoorUnits, busSide.peerPath(), seconds);
+    printf("  discovered %zu/%zu devices, %lu frames decoded, %lu decode errors\n",
+           discovered, bus.unitCount(), rx.framesDecoded, rx.decodeErrors);
+    printf("  commands %lu issued, %lu received by units, %lu confirmed, %lu finished unconfirmed\n",
+           issued, emu.requestsReceived, confirmed, unconfirmed);
+    const TxStats& tx = bridge.getTxStats();
+    printf("  bridge frames %lu sent, %lu deferred, %lu forced, %lu collided\n",
+           tx.framesSent, tx.deferredSends, tx.forcedSends, emu.collisions);
+    printf("  state mismatches: %d\n", mismatches);
+    
+    return (discovered == bus.unitCount() && unconfirmed == 0 && mismatches == 0) ? 0 : 1;
+}
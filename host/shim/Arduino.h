@@ -0,0 +1,41 @@
+#pragma once
+
+// Minimal Arduino core for building the bridge sources on a host machine
+// (replay, benchmarks). Only what src/ uses outside main.cpp is provided.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include "WString.h"
+
+#define HEX 16
+#define DEC 10
+
+using std::abs;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// Host clock is manual: replay and benchmarks set it from capture timestamps.
+// Programs on a real bus (nasa_daemon, pty_loopback) switch it to the system
+// monotonic clock instead; delay() then sleeps
+void hostClockSet(unsigned long micros);
+void hostClockAdvance(unsigned long micros);
+void hostClockUseSystem();
+
+struct EspClass {
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 200000; }
+    uint32_t getMaxAllocHeap() { return 200000; }
+};
+extern EspClass ESP;
+
+#include "HardwareSerial.h"
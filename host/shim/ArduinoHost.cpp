@@ -0,0 +1,34 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+EspClass ESP;
+HardwareSerial Serial;
+HardwareSerial Serial2;
+
+static unsigned long clockMicros = 0;
+static bool systemClock = false;
+
+static unsigned long systemMicros() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long millis() { return micros() / 1000; }
+unsigned long micros() { return systemClock ? systemMicros() : clockMicros; }
+void delay(unsigned long ms) {
+    if (systemClock) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    } else {
+        clockMicros += ms * 1000;
+    }
+}
+void yield() {}
+
+void hostClockSet(unsigned long value) { clockMicros = value; }
+void hostClockAdvance(unsigned long value) { clockMicros += value; }
+void hostClockUseSystem() {
+    systemMicros();
+    systemClock = true;
+}
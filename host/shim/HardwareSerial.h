@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#define SERIAL_8E1 0x800001e
+
+unsigned long micros();
+
+// In-memory UART: tests and replay push bytes into rx, transmitted bytes
+// collect in tx at once but only count as sent (txDone) after their airtime
+// at the configured baud rate. Debug output on Serial is discarded.
+class HardwareSerial {
+public:
+    std::deque<uint8_t> rx;
+    std::vector<uint8_t> tx;
+    unsigned long charMicros = 1146;        // 8E1 at 9600 baud
+    unsigned long txIdleMicros = 0;         // When the last written byte is out
+
+    void begin(unsigned long baud, uint32_t config = 0, int rxPin = -1, int txPin = -1) {
+        charMicros = baud ? 11000000UL / baud : 0;
+        txIdleMicros = micros();
+    }
+    void setTimeout(unsigned long timeout) {}
+    int available() { return (int)rx.size(); }
+    int read() {
+        if (rx.empty()) return -1;
+        int value = rx.front();
+        rx.pop_front();
+        return value;
+    }
+    size_t read(uint8_t* buffer, size_t length) {
+        size_t count = 0;
+        while (count < length && !rx.empty()) {
+            buffer[count++] = rx.front();
+            rx.pop_front();
+        }
+        return count;
+    }
+    size_t write(const uint8_t* buffer, size_t length) {
+        tx.insert(tx.end(), buffer, buffer + length);
+        unsigned long now = micros();
+        if ((long)(now - txIdleMicros) > 0) txIdleMicros = now;
+        txIdleMicros += length * charMicros;
+        return length;
+    }
+    size_t write(uint8_t value) { tx.push_back(value); return 1; }
+    int availableForWrite() { return 128; }
+    void flush() {}
+    // Host only: the ESP32 build asks the IDF driver (uart_wait_tx_done)
+    bool txDone() { return (long)(micros() - txIdleMicros) >= 0; }
+
+    template <typename T> size_t print(const T&) { return 0; }
+    template <typename T> size_t println(const T&) { return 0; }
+    size_t printf(const char* format, ...) { return 0; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial2;
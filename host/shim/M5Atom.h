@@ -0,0 +1,2 @@
+#pragma once
+// Host build: no M5Stack hardware
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string>
+
+// Arduino String on top of std::string
+class String {
+private:
+    std::string str;
+
+public:
+    String() {}
+    String(const char* value) : str(value ? value : "") {}
+    String(const std::string& value) : str(value) {}
+    explicit String(char value) : str(1, value) {}
+    String(int value, unsigned char base = 10) { format(base == 16 ? "%x" : "%d", value); }
+    String(unsigned int value, unsigned char base = 10) { format(base == 16 ? "%x" : "%u", value); }
+    String(long value, unsigned char base = 10) { format(base == 16 ? "%lx" : "%ld", value); }
+    String(unsigned long value, unsigned char base = 10) { format(base == 16 ? "%lx" : "%lu", value); }
+    String(unsigned char value, unsigned char base = 10) : String((unsigned int)value, base) {}
+    String(float value, unsigned int decimals = 2) { format("%.*f", decimals, (double)value); }
+    String(double value, unsigned int decimals = 2) { format("%.*f", decimals, value); }
+
+    const char* c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.size(); }
+    bool isEmpty() const { return str.empty(); }
+    bool reserve(unsigned int size) { str.reserve(size); return true; }
+    char operator[](unsigned int index) const { return index < str.size() ? str[index] : 0; }
+
+    int indexOf(char c, unsigned int from = 0) const { return found(str.find(c, from)); }
+    int indexOf(const char* s, unsigned int from = 0) const { return found(str.find(s, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return found(str.find(s.str, from)); }
+
+    String substring(unsigned int from) const {
+        return from >= str.size() ? String() : String(str.substr(from));
+    }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        return from >= str.size() ? String() : String(str.substr(from, to - from));
+    }
+
+    void replace(const String& find, const String& replacement) {
+        if (find.str.empty()) return;
+        size_t pos = 0;
+        while ((pos = str.find(find.str, pos)) != std::string::npos) {
+            str.replace(pos, find.str.size(), replacement.str);
+            pos += replacement.str.size();
+        }
+    }
+    void toUpperCase() { for (auto& c : str) c = toupper(c); }
+    void toLowerCase() { for (auto& c : str) c = tolower(c); }
+    bool startsWith(const String& prefix) const { return str.compare(0, prefix.str.size(), prefix.str) == 0; }
+    bool endsWith(const String& suffix) const {
+        return str.size() >= suffix.str.size() && str.compare(str.size() - suffix.str.size(), suffix.str.size(), suffix.str) == 0;
+    }
+    long toInt() const { return atol(str.c_str()); }
+    float toFloat() const { return (float)atof(str.c_str()); }
+
+    String& operator+=(const String& other) { str += other.str; return *this; }
+    String& operator+=(const char* other) { str += other; return *this; }
+    String& operator+=(char other) { str += other; return *this; }
+    String& operator+=(int other) { return *this += String(other); }
+    String& operator+=(unsigned long other) { return *this += String(other); }
+
+    friend String operator+(const String& a, const String& b) { return String(a.str + b.str); }
+    friend String operator+(const String& a, const char* b) { return String(a.str + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.str); }
+
+    bool operator==(const String& other) const { return str == other.str; }
+    bool operator==(const char* other) const { return str == other; }
+    bool operator!=(const String& other) const { return str != other.str; }
+    bool operator!=(const char* other) const { return str != other; }
+    bool operator<(const String& other) const { return str < other.str; }
+
+private:
+    static int found(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+
+    template <typename... Args>
+    void format(const char* fmt, Args... args) {
+        char buf[40];
+        snprintf(buf, sizeof(buf), fmt, args...);
+        str = buf;
+    }
+};
@@ -0,0 +1,3 @@
+#pragma once
+// Host build uses the defaults from the example configuration
+#include "../../src/user_config.h.example"
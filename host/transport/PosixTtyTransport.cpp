@@ -0,0 +1,137 @@
+#include "PosixTtyTransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+static speed_t baudConstant(unsigned long baudRate) {
+    switch (baudRate) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return B0;
+    }
+}
+
+bool PosixTtyTransport::begin(unsigned long baudRate) {
+    close();
+    
+    if (path.empty()) {
+        fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+            fprintf(stderr, "%s: %s\n", name(), strerror(errno));
+            close();
+            return false;
+        }
+        peer = ptsname(fd);
+    } else {
+        fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (fd < 0) {
+            fprintf(stderr, "%s: %s\n", name(), strerror(errno));
+            return false;
+        }
+    }
+    
+    if (!configure(baudRate)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool PosixTtyTransport::configure(unsigned long baudRate) {
+    speed_t speed = baudConstant(baudRate);
+    if (speed == B0) {
+        fprintf(stderr, "%s: unsupported baud rate %lu\n", name(), baudRate);
+        return false;
+    }
+    
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        fprintf(stderr, "%s: %s\n", name(), strerror(errno));
+        return false;
+    }
+    
+    // Raw bytes, 8 data bits, even parity, one stop bit; reads never wait
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSIZE | CSTOPB | PARODD | CRTSCTS);
+    tio.c_cflag |= CS8 | PARENB | CLOCAL | CREAD;
+    tio.c_iflag &= ~(INPCK | IXON | IXOFF);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        // A real line without even parity would garble every frame
+        if (!isPseudoTerminal()) {
+            fprintf(stderr, "%s: cannot set 8E1: %s\n", name(), strerror(errno));
+            return false;
+        }
+        
+        // Some pseudo terminal implementations refuse parity settings; a pty
+        // carries bytes, not bits, so the line still works without them
+        tio.c_cflag &= ~PARENB;
+        if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+            fprintf(stderr, "%s: %s\n", name(), strerror(errno));
+            return false;
+        }
+        fprintf(stderr, "%s: even parity not supported, continuing without\n", name());
+    }
+    tcflush(fd, TCIOFLUSH);
+    return true;
+}
+
+void PosixTtyTransport::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    peer.clear();
+}
+
+int PosixTtyTransport::available() {
+    int count = 0;
+    if (fd < 0 || ioctl(fd, FIONREAD, &count) != 0) return 0;
+    return count;
+}
+
+size_t PosixTtyTransport::read(uint8_t* buffer, size_t length) {
+    if (fd < 0) return 0;
+    ssize_t count = ::read(fd, buffer, length);
+    return count > 0 ? (size_t)count : 0;
+}
+
+size_t PosixTtyTransport::write(const uint8_t* data, size_t length) {
+    if (fd < 0) return 0;
+    
+    // Whatever fits the output queue; a full queue (EAGAIN) accepts nothing
+    ssize_t count;
+    do {
+        count = ::write(fd, data, length);
+    } while (count < 0 && errno == EINTR);
+    return count > 0 ? (size_t)count : 0;
+}
+
+bool PosixTtyTransport::txDone() {
+    // Bytes still in the kernel's output queue; a USB adapter may hold a few
+    // more, which is within the turnaround holdoff. Unsupported means done
+    int queued = 0;
+    if (fd < 0 || ioctl(fd, TIOCOUTQ, &queued) != 0) return true;
+    return queued == 0;
+}
+
+bool PosixTtyTransport::waitReadable(int timeoutMs) {
+    if (fd < 0) return false;
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, timeoutMs) > 0 && (pfd.revents & POLLIN);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include "ByteTransport.h"
+
+// Bus on a POSIX serial device, e.g. a USB-RS485 dongle at /dev/ttyUSB0, set to
+// raw 8E1 and non-blocking; begin() fails if the device refuses even parity.
+// Without a path begin() creates a pseudo terminal instead and this end plays
+// the bus: whatever opens peerPath() (a bridge, or socat/a capture player for a
+// real one) talks to it as if it were a dongle. Pseudo terminals carry bytes,
+// not bits, and may run without parity.
+class PosixTtyTransport : public ByteTransport {
+private:
+    std::string path;
+    std::string peer;                   // Slave side of the pty we created
+    int fd = -1;
+    
+    bool configure(unsigned long baudRate);
+    const char* name() const { return path.empty() ? "pty" : path.c_str(); }
+    
+    // The pty we created, or the other end of one (a bridge opening peerPath())
+    bool isPseudoTerminal() const { return path.empty() || path.compare(0, 9, "/dev/pts/") == 0; }
+    
+public:
+    explicit PosixTtyTransport(const char* devicePath = nullptr) : path(devicePath ? devicePath : "") {}
+    ~PosixTtyTransport() override { close(); }
+    
+    bool begin(unsigned long baudRate) override;
+    void close();
+    
+    int available() override;
+    size_t read(uint8_t* buffer, size_t length) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    bool txDone() override;
+    
+    // Wait up to timeoutMs for bytes to read; false on timeout
+    bool waitReadable(int timeoutMs);
+    
+    int descriptor() const { return fd; }
+    
+    // Device the other end opens when begin() created a pty, else empty
+    const char* peerPath() const { return peer.c_str(); }
+};
@@ -0,0 +1,53 @@
+#include "BusCapture.h"
+#include <string.h>
+
+void writeCaptureFileHeader(uint8_t* dest) {
+    memcpy(dest, "NASACAP", 7);
+    dest[7] = CAPTURE_FORMAT_VERSION;
+}
+
+void BusCapture::start() {
+    // A new capture starts clean, so a stream never begins mid-record
+    buffer.clear();
+    records = 0;
+    droppedRecords = 0;
+    enabled = true;
+}
+
+void BusCapture::record(const ByteView& bytes, DecodeResult result, uint8_t flags, unsigned long timestamp) {
+    if (!enabled) return;
+
+    size_t length = bytes.size();
+    if (length > 0xFFFF || buffer.freeSpace() < CAPTURE_RECORD_HEADER_SIZE + length) {
+        droppedRecords++;
+        return;
+    }
+
+    buffer.push(timestamp & 0xFF);
+    buffer.push((timestamp >> 8) & 0xFF);
+    buffer.push((timestamp >> 16) & 0xFF);
+    buffer.push((timestamp >> 24) & 0xFF);
+    buffer.push(length & 0xFF);
+    buffer.push((length >> 8) & 0xFF);
+    buffer.push((uint8_t)result);
+    buffer.push(flags);
+
+    // Copy the payload - at most two writes when the free space wraps
+    size_t copied = 0;
+    while (copied < length) {
+        size_t contiguous = 0;
+        uint8_t* dest = buffer.writePointer(contiguous);
+        if (contiguous > length - copied) contiguous = length - copied;
+        bytes.copyTo(dest, copied, contiguous);
+        buffer.commit(contiguous);
+        copied += contiguous;
+    }
+    records++;
+}
+
+size_t BusCapture::read(uint8_t* dest, size_t capacity) {
+    size_t length = buffer.size() < capacity ? buffer.size() : capacity;
+    buffer.view(0, length).copyTo(dest, 0, length);
+    buffer.consume(length);
+    return length;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include "RingBuffer.h"
+#include "NasaDecoder.h"
+#include "user_config.h"
+
+#ifndef CAPTURE_TCP_PORT
+#define CAPTURE_TCP_PORT 2323                   // Raw bus capture stream
+#endif
+
+// Capture stream format (little-endian):
+//   file header: "NASACAP" + version byte (8 bytes), sent once per stream/download
+//   record:      uint32 timestamp (micros), uint16 length, uint8 DecodeResult,
+//                uint8 flags, then `length` raw bytes
+// Records cover every byte the decoder consumed - decoded frames as well as
+// rejected spans - plus the frames we transmitted (CAPTURE_FLAG_TX). The
+// timestamp is when the record's last byte was on the wire: read from the UART
+// for received spans, the end of transmission for ours. Received records are
+// in bus order; a transmitted one is written when its TX-done event arrives,
+// so it can follow received records stamped later.
+static const uint8_t CAPTURE_FORMAT_VERSION = 1;
+static const size_t CAPTURE_FILE_HEADER_SIZE = 8;
+static const size_t CAPTURE_RECORD_HEADER_SIZE = 8;
+static const uint8_t CAPTURE_FLAG_TX = 0x01;
+
+void writeCaptureFileHeader(uint8_t* dest);
+
+class BusCapture : public FrameTap {
+private:
+    RingBuffer<8192> buffer;            // About 8 s of a busy 9600 baud bus
+    bool enabled = false;
+    unsigned long records = 0;
+    unsigned long droppedRecords = 0;   // Buffer full - the reader is not keeping up
+
+public:
+    void start();
+    void stop() { enabled = false; }
+    bool isEnabled() const { return enabled; }
+
+    // Append one record; whole records are dropped when they do not fit
+    void record(const ByteView& bytes, DecodeResult result, uint8_t flags, unsigned long timestamp);
+
+    // FrameTap: receive-side spans from the decoder
+    void onFrame(const ByteView& bytes, DecodeResult result, unsigned long arrivalMicros) override {
+        record(bytes, result, 0, arrivalMicros);
+    }
+
+    // Drain buffered record bytes (records may be split across reads)
+    size_t read(uint8_t* dest, size_t capacity);
+    size_t pending() const { return buffer.size(); }
+
+    unsigned long getRecordCount() const { return records; }
+    unsigned long getDroppedCount() const { return droppedRecords; }
+};
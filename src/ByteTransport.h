@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte stream to the RS485 bus. The bridge only moves bytes through it, so the
+// same core runs on the ESP32 UART (UartTransport) or on a Linux tty/pty
+// (host/transport/PosixTtyTransport). Lines are 8E1, as Samsung units expect.
+class ByteTransport {
+public:
+    virtual ~ByteTransport() {}
+    
+    // Open and configure the line; false if the device could not be opened
+    virtual bool begin(unsigned long baudRate) = 0;
+    
+    // Bytes that can be read without blocking
+    virtual int available() = 0;
+    
+    // Never blocks; returns the bytes copied into buffer
+    virtual size_t read(uint8_t* buffer, size_t length) = 0;
+    
+    // Never blocks: queues as many bytes as fit for transmission and returns
+    // that count; the caller writes the rest later
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+    
+    // Never blocks: true once everything written has left the transmitter
+    // (last stop bit out), so the line can turn around
+    virtual bool txDone() = 0;
+};
@@ -1,50 +1,366 @@
 #include "CommandQueue.h"
 #include "config.h"
 
-QueuedCommand* CommandQueue::addCommand(const String& address, const QueuedRequest& request) {
-    auto cmd = std::unique_ptr<QueuedCommand>(new QueuedCommand(address, request));
-    QueuedCommand* cmdPtr = cmd.get();
-    commands.push_back(std::move(cmd));
+const char* commandPriorityToString(CommandPriority priority) {
+    switch (priority) {
+        case CommandPriority::Interactive: return "interactive";
+        case CommandPriority::Automation: return "automation";
+        case CommandPriority::Background: return "background";
+        default: return "unknown";
+    }
+}
+
+const char* commandStateToString(CommandState state) {
+    switch (state) {
+        case CommandState::Pending: return "pending";
+        case CommandState::Sent: return "sent";
+        case CommandState::Acknowledged: return "acknowledged";
+        case CommandState::Failed: return "failed";
+        case CommandState::Completed: return "completed";
+        case CommandState::Expired: return "expired";
+        default: return "unknown";
+    }
+}
+
+bool commandPriorityFromString(const String& str, CommandPriority& priority) {
+    for (int i = 0; i < COMMAND_PRIORITY_COUNT; i++) {
+        if (str == commandPriorityToString((CommandPriority)i)) {
+            priority = (CommandPriority)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void QueuedRequest::merge(const QueuedRequest& other) {
+    if (other.hasPower) {
+        power = other.power;
+        hasPower = true;
+    }
+    if (other.hasMode) {
+        mode = other.mode;
+        hasMode = true;
+    }
+    if (other.hasTargetTemperature) {
+        targetTemperatureTenths = other.targetTemperatureTenths;
+        hasTargetTemperature = true;
+    }
+    if (other.hasFanMode) {
+        fanMode = other.fanMode;
+        hasFanMode = true;
+    }
+    if (other.hasSwingVertical) {
+        swingVertical = other.swingVertical;
+        hasSwingVertical = true;
+    }
+    if (other.hasSwingHorizontal) {
+        swingHorizontal = other.swingHorizontal;
+        hasSwingHorizontal = true;
+    }
+    if (other.hasPreset) {
+        preset = other.preset;
+        hasPreset = true;
+    }
+}
+
+uint32_t QueuedRequest::fieldMask() const {
+    uint32_t mask = 0;
+    if (hasPower) mask |= fieldBit(DeviceField::Power);
+    if (hasMode) mask |= fieldBit(DeviceField::Mode);
+    if (hasTargetTemperature) mask |= fieldBit(DeviceField::TargetTemperature);
+    if (hasFanMode) mask |= fieldBit(DeviceField::FanMode);
+    if (hasSwingVertical) mask |= fieldBit(DeviceField::SwingVertical);
+    if (hasSwingHorizontal) mask |= fieldBit(DeviceField::SwingHorizontal);
+    if (hasPreset) mask |= fieldBit(DeviceField::Preset);
+    return mask;
+}
+
+bool QueuedRequest::matches(const DeviceState& state) const {
+    if (hasPower && state.power != power) return false;
+    if (hasMode && (int)state.mode != mode) return false;
+    if (hasTargetTemperature && fabs(state.targetTemperature - targetTemperatureTenths / 10.0f) > 0.1) return false;
+    if (hasFanMode && (int)state.fanMode != fanMode) return false;
+    if (hasSwingVertical && state.swingVertical != swingVertical) return false;
+    if (hasSwingHorizontal && state.swingHorizontal != swingHorizontal) return false;
+    if (hasPreset && (int)state.preset != preset) return false;
+    return true;
+}
+
+QueuedCommand* CommandQueue::allocate() {
+    QueuedCommand* oldestFinished = nullptr;
+    
+    for (auto& cmd : pool) {
+        if (!cmd.inUse) return &cmd;
+        // Finished commands are only kept for status; the oldest makes room
+        if (isFinished(cmd) && !cmd.fallbackDue &&
+            (!oldestFinished || (long)(cmd.finishedTime - oldestFinished->finishedTime) < 0)) {
+            oldestFinished = &cmd;
+        }
+    }
+    
+    if (oldestFinished) release(*oldestFinished);
+    return oldestFinished;
+}
+
+void CommandQueue::release(QueuedCommand& cmd) {
+    releaseSequence(&cmd, SequenceSlot::Expired);
+    releaseGroup(cmd);
+    cmd = QueuedCommand();
+}
+
+void CommandQueue::releaseGroup(QueuedCommand& cmd) {
+    // The member count stays on the command for its status
+    if (cmd.group < 0) return;
+    groups[cmd.group].inUse = false;
+    groups[cmd.group].pending = 0;
+    cmd.group = -1;
+}
+
+bool CommandQueue::hasFreeSlot() const {
+    for (const auto& cmd : pool) {
+        if (!cmd.inUse || (isFinished(cmd) && !cmd.fallbackDue)) return true;
+    }
+    return false;
+}
+
+bool CommandQueue::setMembers(QueuedCommand& cmd, const uint32_t* members, size_t count) {
+    if (cmd.group < 0) {
+        for (int i = 0; i < GROUP_POOL_SIZE; i++) {
+            if (!groups[i].inUse) {
+                cmd.group = i;
+                break;
+            }
+        }
+        if (cmd.group < 0) return false;
+    }
+    
+    GroupMembers& group = groups[cmd.group];
+    if (count > DeviceRegistry::MAX_DEVICES) count = DeviceRegistry::MAX_DEVICES;
+    group.inUse = true;
+    group.pending = count;
+    memcpy(group.members, members, count * sizeof(uint32_t));
     
-    DEBUG_PRINTF("Command queued for %s, queue size: %d\n", address.c_str(), commands.size());
-    return cmdPtr;
+    cmd.broadcast = true;
+    cmd.memberCount = count;
+    return true;
+}
+
+QueuedCommand* CommandQueue::addCommand(const Address& address, const QueuedRequest& request,
+                                        const uint8_t* frame, size_t frameLength,
+                                        CommandPriority priority, unsigned long deadlineMs,
+                                        const uint32_t* members, size_t memberCount) {
+    if (frameLength == 0 || frameLength > MAX_COMMAND_FRAME_SIZE) return nullptr;
+    
+    QueuedCommand* cmd = allocate();
+    if (!cmd) {
+        DEBUG_PRINTF("Command queue full, %s refused\n", address.toString().c_str());
+        return nullptr;
+    }
+    
+    cmd->inUse = true;
+    cmd->id = nextId++;
+    if (nextId == 0) nextId = 1;
+    cmd->targetAddress = address;
+    cmd->request = request;
+    if (members && !setMembers(*cmd, members, memberCount)) {
+        DEBUG_PRINTF("No free group slot, %s refused\n", address.toString().c_str());
+        release(*cmd);
+        return nullptr;
+    }
+    
+    memcpy(cmd->frame, frame, frameLength);
+    cmd->frameLength = frameLength;
+    cmd->priority = priority;
+    cmd->queuedTime = millis();
+    cmd->order = nextOrder++;
+    if (deadlineMs > 0) {
+        cmd->hasDeadline = true;
+        cmd->deadline = cmd->queuedTime + deadlineMs;
+    }
+    
+    DEBUG_PRINTF("Command queued for %s, queue size: %d\n", address.toString().c_str(), getPendingCount());
+    return cmd;
+}
+
+const QueuedCommand* CommandQueue::findById(uint32_t id) const {
+    if (id == 0) return nullptr;
+    for (const auto& cmd : pool) {
+        if (cmd.inUse && cmd.id == id) return &cmd;
+    }
+    return nullptr;
+}
+
+QueuedCommand* CommandQueue::findUnsent(const Address& address) {
+    for (auto& cmd : pool) {
+        // Retries go back to Pending too, but those frames are already on the bus
+        if (cmd.inUse && cmd.targetAddress == address && cmd.state == CommandState::Pending && cmd.retryCount == 0) {
+            return &cmd;
+        }
+    }
+    return nullptr;
+}
+
+void CommandQueue::mergeCommand(QueuedCommand* cmd, const QueuedRequest& merged,
+                                const uint8_t* frame, size_t frameLength,
+                                CommandPriority priority, unsigned long deadlineMs,
+                                const uint32_t* members, size_t memberCount) {
+    if (!cmd || frameLength == 0 || frameLength > MAX_COMMAND_FRAME_SIZE) return;
+    
+    cmd->request = merged;
+    memcpy(cmd->frame, frame, frameLength);
+    cmd->frameLength = frameLength;
+    if (cmd->mergedRequests < 255) cmd->mergedRequests++;
+    
+    // Same group slot, refreshed with the members known now
+    if (members) setMembers(*cmd, members, memberCount);
+    
+    // The merged fields must not be dropped because an older part had a deadline
+    if (priority < cmd->priority) cmd->priority = priority;
+    if (deadlineMs == 0) {
+        cmd->hasDeadline = false;
+    } else if (cmd->hasDeadline) {
+        unsigned long deadline = millis() + deadlineMs;
+        if ((long)(deadline - cmd->deadline) > 0) cmd->deadline = deadline;
+    }
+    
+    DEBUG_PRINTF("Command for %s merged (%d requests folded in)\n",
+                 cmd->targetAddress.toString().c_str(), cmd->mergedRequests);
+}
+
+bool CommandQueue::isAwaitingAck(const Address& address) const {
+    for (const auto& cmd : pool) {
+        if (cmd.inUse && cmd.targetAddress == address && cmd.state == CommandState::Sent) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CommandQueue::runsBefore(const QueuedCommand* a, const QueuedCommand* b) const {
+    if (a->priority != b->priority) return a->priority < b->priority;
+    if (a->hasDeadline != b->hasDeadline) return a->hasDeadline;
+    if (a->hasDeadline && a->deadline != b->deadline) return (long)(a->deadline - b->deadline) < 0;
+    return (int32_t)(a->order - b->order) < 0;
+}
+
+void CommandQueue::expire(QueuedCommand* cmd) {
+    DEBUG_PRINTF("Command for %s expired before it could be sent\n", cmd->targetAddress.toString().c_str());
+    finish(*cmd, CommandState::Expired);
+    releaseSequence(cmd, SequenceSlot::Expired);
+    classStats[(int)cmd->priority].expired++;
+}
+
+void CommandQueue::finish(QueuedCommand& cmd, CommandState state) {
+    if (cmd.state == CommandState::Acknowledged) unwatchAll(cmd);
+    cmd.state = state;
+    cmd.finishedTime = millis();
+    
+    // A finished group command only needs its members for the fallback; the
+    // scarce group slot is free for the next one while this is kept for status
+    if (!cmd.fallbackDue) releaseGroup(cmd);
+}
+
+void CommandQueue::watch(QueuedCommand& cmd) {
+    if (!devices) return;
+    uint32_t slot = 1UL << (&cmd - pool);
+    uint32_t fields = cmd.request.fieldMask();
+    
+    if (!cmd.broadcast) {
+        DeviceEntry* device = devices->find(cmd.targetAddress);
+        if (!device) return;
+        device->awaitingCommands |= slot;
+        device->awaitingFields |= fields;
+        return;
+    }
+    
+    const GroupMembers& group = groups[cmd.group];
+    for (int i = 0; i < group.pending; i++) {
+        DeviceEntry* device = devices->find(Address::unpack(group.members[i]));
+        if (!device) continue;
+        device->awaitingCommands |= slot;
+        device->awaitingFields |= fields;
+    }
+}
+
+void CommandQueue::unwatch(QueuedCommand& cmd, DeviceEntry& device) {
+    device.awaitingCommands &= ~(1UL << (&cmd - pool));
+    
+    // Rebuild the field union from the commands still waiting
+    device.awaitingFields = 0;
+    for (uint32_t waiting = device.awaitingCommands; waiting; waiting &= waiting - 1) {
+        device.awaitingFields |= pool[__builtin_ctz(waiting)].request.fieldMask();
+    }
+}
+
+void CommandQueue::unwatchAll(QueuedCommand& cmd) {
+    if (!devices) return;
+    
+    if (!cmd.broadcast) {
+        DeviceEntry* device = devices->find(cmd.targetAddress);
+        if (device) unwatch(cmd, *device);
+        return;
+    }
+    
+    // Members that confirmed are already off the index
+    const GroupMembers& group = groups[cmd.group];
+    for (int i = 0; i < group.pending; i++) {
+        DeviceEntry* device = devices->find(Address::unpack(group.members[i]));
+        if (device) unwatch(cmd, *device);
+    }
 }
 
 QueuedCommand* CommandQueue::getNextCommandToSend() {
     unsigned long now = millis();
+    QueuedCommand* best = nullptr;
     
-    for (auto& cmd : commands) {
-        if (!cmd) continue;
+    for (auto& slot : pool) {
+        if (!slot.inUse) continue;
+        QueuedCommand* cmd = &slot;
         
         switch (cmd->state) {
             case CommandState::Pending:
-                // Ready to send immediately
-                return cmd.get();
+                if (cmd->hasDeadline && (long)(now - cmd->deadline) > 0) {
+                    expire(cmd);
+                    break;
+                }
+                // One frame in flight per device; later requests wait here and
+                // are merged until the previous one is ACKed or gives up
+                if (cmd->retryCount == 0 && isAwaitingAck(cmd->targetAddress)) break;
+                if (!best || runsBefore(cmd, best)) best = cmd;
+                break;
                 
             case CommandState::Sent:
-                // Check for ACK timeout
-                if (now - cmd->sentTime > ACK_TIMEOUT_MS) {
+                // Check for ACK timeout (backed off and jittered when sent)
+                if (now - cmd->sentTime > cmd->timeoutMs) {
                     if (cmd->retryCount < MAX_RETRIES) {
-                        // Retry after delay
-                        if (now - cmd->sentTime > ACK_TIMEOUT_MS + RETRY_DELAY_MS) {
-                            DEBUG_PRINTF("Retrying command for %s (attempt %d/%d)\n", 
-                                       cmd->targetAddress.c_str(), cmd->retryCount + 1, MAX_RETRIES);
-                            cmd->state = CommandState::Pending;
-                            return cmd.get();
+                        if (cmd->hasDeadline && (long)(now - cmd->deadline) > 0) {
+                            expire(cmd);
+                            break;
                         }
+                        DEBUG_PRINTF("Retrying command for %s (attempt %d/%d)\n", 
+                                   cmd->targetAddress.toString().c_str(), cmd->retryCount + 1, MAX_RETRIES);
+                        cmd->state = CommandState::Pending;
+                        if (!best || runsBefore(cmd, best)) best = cmd;
                     } else {
                         // Max retries exceeded
-                        DEBUG_PRINTF("Command failed for %s - max retries exceeded\n", cmd->targetAddress.c_str());
-                        cmd->state = CommandState::Failed;
+                        DEBUG_PRINTF("Command failed for %s - max retries exceeded\n", cmd->targetAddress.toString().c_str());
+                        finish(*cmd, CommandState::Failed);
+                        releaseSequence(cmd, SequenceSlot::Expired);
                     }
                 }
                 break;
                 
             case CommandState::Acknowledged:
                 // Check for state confirmation timeout
-                if (now - cmd->sentTime > STATE_CONFIRM_TIMEOUT_MS) {
-                    DEBUG_PRINTF("Command for %s acknowledged but state not confirmed\n", cmd->targetAddress.c_str());
-                    cmd->state = CommandState::Completed;  // Consider it done anyway
+                if (now - cmd->sentTime > cmd->timeoutMs) {
+                    if (cmd->broadcast && groups[cmd->group].pending > 0) {
+                        DEBUG_PRINTF("Group command for %s: %d members unconfirmed, retrying individually\n",
+                                   cmd->targetAddress.toString().c_str(), groups[cmd->group].pending);
+                        cmd->fallbackDue = true;
+                    } else {
+                        DEBUG_PRINTF("Command for %s acknowledged but state not confirmed\n", cmd->targetAddress.toString().c_str());
+                    }
+                    finish(*cmd, CommandState::Completed);  // Consider it done anyway
                 }
                 break;
                 
@@ -53,100 +369,281 @@ QueuedCommand* CommandQueue::getNextCommandToSend() {
         }
     }
     
-    return nullptr;
+    return best;
+}
+
+LinkTiming* CommandQueue::linkFor(const Address& address) {
+    if (!devices) return nullptr;
+    DeviceEntry* device = devices->find(address);
+    return device ? &device->link : nullptr;
+}
+
+unsigned long CommandQueue::ackTimeout(const LinkTiming* link) {
+    return link ? link->ack.timeout(ACK_TIMEOUT_INITIAL_MS, ACK_TIMEOUT_MIN_MS, ACK_TIMEOUT_MAX_MS)
+                : ACK_TIMEOUT_INITIAL_MS;
 }
 
-void CommandQueue::markCommandSent(QueuedCommand* cmd, uint8_t seqNum) {
-    if (!cmd) return;
+unsigned long CommandQueue::confirmTimeout(const LinkTiming* link) {
+    return link ? link->confirm.timeout(CONFIRM_TIMEOUT_INITIAL_MS, CONFIRM_TIMEOUT_MIN_MS, CONFIRM_TIMEOUT_MAX_MS)
+                : CONFIRM_TIMEOUT_INITIAL_MS;
+}
+
+unsigned long CommandQueue::retryTimeout(const QueuedCommand& cmd) {
+    // Doubled for every earlier attempt, plus up to a quarter in jitter so
+    // retries of commands sent together do not collide again in lockstep
+    unsigned long timeout = ackTimeout(linkFor(cmd.targetAddress));
+    for (int i = 1; i < cmd.retryCount && timeout < RETRY_BACKOFF_MAX_MS; i++) timeout *= 2;
+    if (timeout > RETRY_BACKOFF_MAX_MS) timeout = RETRY_BACKOFF_MAX_MS;
+    
+    // xorshift32
+    jitterState ^= jitterState << 13;
+    jitterState ^= jitterState >> 17;
+    jitterState ^= jitterState << 5;
+    return timeout + jitterState % (timeout / 4 + 1);
+}
+
+unsigned long CommandQueue::confirmTimeout(const QueuedCommand& cmd) {
+    // Every member of a group needs bus time for its notification
+    if (cmd.broadcast) return CONFIRM_TIMEOUT_INITIAL_MS + cmd.memberCount * GROUP_CONFIRM_MS_PER_MEMBER;
+    return confirmTimeout(linkFor(cmd.targetAddress));
+}
+
+uint8_t CommandQueue::allocateSequence() {
+    // Round robin from the last number handed out, so a number is reused as
+    // late as possible; 0 is never used and InFlight numbers are skipped
+    for (int i = 0; i < 255; i++) {
+        uint8_t candidate = nextSequenceNumber;
+        nextSequenceNumber = nextSequenceNumber == 255 ? 1 : nextSequenceNumber + 1;
+        if (slots[candidate] != SequenceSlot::InFlight) return candidate;
+    }
+    return 0;
+}
+
+void CommandQueue::releaseSequence(QueuedCommand* cmd, SequenceSlot outcome) {
+    uint8_t seq = cmd->sequenceNumber;
+    if (seq != 0 && inFlight[seq] == cmd) {
+        inFlight[seq] = nullptr;
+        slots[seq] = outcome;
+    }
+}
+
+uint8_t CommandQueue::markCommandSent(QueuedCommand* cmd) {
+    if (!cmd) return 0;
+    
+    uint8_t seqNum = cmd->sequenceNumber;
+    if (seqNum == 0 || inFlight[seqNum] != cmd) {
+        seqNum = allocateSequence();
+        if (seqNum == 0) {
+            DEBUG_PRINTLN("No free packet number, command held back");
+            return 0;
+        }
+        inFlight[seqNum] = cmd;
+        slots[seqNum] = SequenceSlot::InFlight;
+    }
     
     cmd->state = CommandState::Sent;
     cmd->sentTime = millis();
     cmd->sequenceNumber = seqNum;
+    if (cmd->retryCount == 0) {
+        cmd->firstSentTime = cmd->sentTime;
+        QueueClassStats& stats = classStats[(int)cmd->priority];
+        unsigned long waited = cmd->sentTime - cmd->queuedTime;
+        stats.sent++;
+        stats.totalWaitMs += waited;
+        if (waited > stats.maxWaitMs) stats.maxWaitMs = waited;
+    }
     cmd->retryCount++;
     
-    DEBUG_PRINTF("Command sent to %s with seq %d\n", cmd->targetAddress.c_str(), seqNum);
+    if (cmd->broadcast) {
+        // No ACK will come; go straight to waiting for the members' notifications
+        cmd->state = CommandState::Acknowledged;
+        cmd->timeoutMs = confirmTimeout(*cmd);
+        releaseSequence(cmd, SequenceSlot::Acked);
+        watch(*cmd);
+    } else {
+        cmd->timeoutMs = retryTimeout(*cmd);
+    }
+    
+    DEBUG_PRINTF("Command sent to %s with seq %d\n", cmd->targetAddress.toString().c_str(), seqNum);
+    return seqNum;
 }
 
-void CommandQueue::handleAck(uint8_t sequenceNumber) {
-    for (auto& cmd : commands) {
-        if (cmd && cmd->state == CommandState::Sent && cmd->sequenceNumber == sequenceNumber) {
-            DEBUG_PRINTF("ACK received for command to %s (seq %d)\n", 
-                       cmd->targetAddress.c_str(), sequenceNumber);
-            cmd->state = CommandState::Acknowledged;
-            cmd->sentTime = millis();  // Reset timer for state confirmation
-            return;
-        }
+void CommandQueue::markTransmitted(uint32_t id, unsigned long doneTime) {
+    for (auto& cmd : pool) {
+        if (!cmd.inUse || cmd.id != id) continue;
+        // Once ACKed the timers already run from the ACK
+        bool awaitingAck = cmd.state == CommandState::Sent;
+        bool broadcastPending = cmd.broadcast && cmd.state == CommandState::Acknowledged;
+        if (awaitingAck || broadcastPending) cmd.sentTime = doneTime;
+        return;
     }
-    
-    DEBUG_PRINTF("ACK received for unknown sequence %d\n", sequenceNumber);
 }
 
-void CommandQueue::checkStateConfirmation(const String& address, bool power, int mode, 
-                                        float targetTemp, int fanMode, int preset) {
-    for (auto& cmd : commands) {
-        if (!cmd || cmd->targetAddress != address || cmd->state != CommandState::Acknowledged) {
-            continue;
-        }
-        
-        bool stateMatches = true;
+uint8_t CommandQueue::takeSequence() {
+    uint8_t seqNum = allocateSequence();
+    if (seqNum != 0) slots[seqNum] = SequenceSlot::Expired;
+    return seqNum;
+}
+
+void CommandQueue::handleAck(uint8_t sequenceNumber, unsigned long arrivalTime) {
+    QueuedCommand* cmd = inFlight[sequenceNumber];
+    if (cmd) {
+        // An ACK for an earlier attempt counts too: retries reuse the number
+        DEBUG_PRINTF("ACK received for command to %s (seq %d)\n", 
+                   cmd->targetAddress.toString().c_str(), sequenceNumber);
+        // Timed by when the answer was read, not by when the loop decoded it;
+        // never before the frame it answers went out
+        unsigned long now = (long)(arrivalTime - cmd->sentTime) < 0 ? cmd->sentTime : arrivalTime;
+        LinkTiming* link = linkFor(cmd->targetAddress);
+        // Karn: after a retry the ACK may answer any attempt, so only a
+        // single-send round trip is a sample
+        if (link && cmd->retryCount == 1) link->ack.sample(now - cmd->sentTime);
         
-        // Check if current state matches expected state
-        if (cmd->expectedState.hasPower && power != cmd->expectedState.power) {
-            stateMatches = false;
-        }
-        if (cmd->expectedState.hasMode && mode != cmd->expectedState.mode) {
-            stateMatches = false;
-        }
-        if (cmd->expectedState.hasTargetTemp && 
-            abs(targetTemp - cmd->expectedState.targetTemp) > 0.1) {
-            stateMatches = false;
-        }
-        if (cmd->expectedState.hasFanMode && fanMode != cmd->expectedState.fanMode) {
-            stateMatches = false;
+        cmd->state = CommandState::Acknowledged;
+        cmd->sentTime = now;  // Reset timer for state confirmation
+        cmd->ackTime = now;
+        cmd->timeoutMs = confirmTimeout(*cmd);
+        releaseSequence(cmd, SequenceSlot::Acked);
+        watch(*cmd);
+        ackStats.acks++;
+        return;
+    }
+    
+    switch (slots[sequenceNumber]) {
+        case SequenceSlot::Acked:
+            ackStats.duplicateAcks++;
+            DEBUG_PRINTF("Duplicate ACK for sequence %d\n", sequenceNumber);
+            break;
+        case SequenceSlot::Expired:
+            ackStats.staleAcks++;
+            DEBUG_PRINTF("Stale ACK for sequence %d\n", sequenceNumber);
+            break;
+        default:
+            ackStats.unknownAcks++;
+            DEBUG_PRINTF("ACK received for unknown sequence %d\n", sequenceNumber);
+            break;
+    }
+}
+
+void CommandQueue::handleNack(uint8_t sequenceNumber, unsigned long arrivalTime) {
+    QueuedCommand* cmd = inFlight[sequenceNumber];
+    if (!cmd) {
+        DEBUG_PRINTF("NACK received for unknown sequence %d\n", sequenceNumber);
+        return;
+    }
+    
+    // The unit refused the request; sending it again would be refused too
+    ackStats.nacks++;
+    LinkTiming* link = linkFor(cmd->targetAddress);
+    if (link) {
+        link->nacks++;
+        if (cmd->retryCount == 1 && (long)(arrivalTime - cmd->sentTime) >= 0) link->ack.sample(arrivalTime - cmd->sentTime);
+    }
+    DEBUG_PRINTF("NACK received for command to %s (seq %d), failing it\n",
+                 cmd->targetAddress.toString().c_str(), sequenceNumber);
+    finish(*cmd, CommandState::Failed);
+    releaseSequence(cmd, SequenceSlot::Expired);
+}
+
+void CommandQueue::checkStateConfirmation(const Address& address, const DeviceState& state, uint32_t reported) {
+    DeviceEntry* device = devices ? devices->find(address) : nullptr;
+    if (!device || !(device->awaitingFields & reported)) return;
+    
+    for (uint32_t waiting = device->awaitingCommands; waiting; waiting &= waiting - 1) {
+        QueuedCommand& cmd = pool[__builtin_ctz(waiting)];
+        if (!(cmd.request.fieldMask() & reported) || !cmd.request.matches(state)) continue;
+        confirm(cmd, *device);
+    }
+}
+
+void CommandQueue::confirm(QueuedCommand& cmd, DeviceEntry& device) {
+    unwatch(cmd, device);
+    
+    if (cmd.broadcast) {
+        GroupMembers& group = groups[cmd.group];
+        uint32_t key = device.address.pack();
+        for (int i = 0; i < group.pending; i++) {
+            if (group.members[i] == key) {
+                group.members[i] = group.members[--group.pending];
+                break;
+            }
         }
-        if (cmd->expectedState.hasPreset && preset != cmd->expectedState.preset) {
-            stateMatches = false;
+        DEBUG_PRINTF("Group command to %s confirmed by %s, %d members left\n",
+                   cmd.targetAddress.toString().c_str(), device.address.toString().c_str(), group.pending);
+        if (group.pending == 0) {
+            cmd.confirmed = true;
+            finish(cmd, CommandState::Completed);
         }
+        return;
+    }
+    
+    DEBUG_PRINTF("State confirmed for command to %s\n", device.address.toString().c_str());
+    // Only unicast confirmations are sampled; group members queue behind each other
+    device.link.confirm.sample(millis() - cmd.ackTime);
+    cmd.confirmed = true;
+    finish(cmd, CommandState::Completed);
+}
+
+bool CommandQueue::takeUnconfirmedMember(Address& member, QueuedRequest& request, CommandPriority& priority) {
+    for (auto& cmd : pool) {
+        if (!cmd.inUse || !cmd.fallbackDue) continue;
         
-        if (stateMatches) {
-            DEBUG_PRINTF("State confirmed for command to %s\n", address.c_str());
-            cmd->state = CommandState::Completed;
+        GroupMembers& group = groups[cmd.group];
+        if (group.pending == 0) {
+            cmd.fallbackDue = false;
+            releaseGroup(cmd);
+            continue;
+        }
+        member = Address::unpack(group.members[--group.pending]);
+        request = cmd.request;
+        priority = cmd.priority;
+        if (group.pending == 0) {
+            cmd.fallbackDue = false;
+            releaseGroup(cmd);
         }
+        return true;
     }
+    return false;
 }
 
 void CommandQueue::cleanup() {
-    // Remove completed and failed commands older than 10 seconds
-    unsigned long cutoffTime = millis() - 10000;
+    unsigned long now = millis();
     
-    commands.erase(
-        std::remove_if(commands.begin(), commands.end(),
-            [cutoffTime](const std::unique_ptr<QueuedCommand>& cmd) {
-                if (!cmd) return true;
-                return (cmd->state == CommandState::Completed || cmd->state == CommandState::Failed) &&
-                       (cmd->sentTime < cutoffTime);
-            }),
-        commands.end()
-    );
+    for (auto& cmd : pool) {
+        if (cmd.inUse && isFinished(cmd) && !cmd.fallbackDue && now - cmd.finishedTime > FINISHED_RETENTION_MS) {
+            release(cmd);
+        }
+    }
 }
 
 size_t CommandQueue::getPendingCount() const {
     size_t count = 0;
-    for (const auto& cmd : commands) {
-        if (cmd && (cmd->state == CommandState::Pending || cmd->state == CommandState::Sent)) {
+    for (const auto& cmd : pool) {
+        if (cmd.inUse && (cmd.state == CommandState::Pending || cmd.state == CommandState::Sent)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t CommandQueue::getPendingCount(CommandPriority priority) const {
+    size_t count = 0;
+    for (const auto& cmd : pool) {
+        if (cmd.inUse && cmd.priority == priority &&
+            (cmd.state == CommandState::Pending || cmd.state == CommandState::Sent)) {
             count++;
         }
     }
     return count;
 }
 
-bool CommandQueue::hasCommandsForAddress(const String& address) const {
-    for (const auto& cmd : commands) {
-        if (cmd && cmd->targetAddress == address && 
-            (cmd->state == CommandState::Pending || cmd->state == CommandState::Sent || 
-             cmd->state == CommandState::Acknowledged)) {
+bool CommandQueue::hasCommandsForAddress(const Address& address) const {
+    for (const auto& cmd : pool) {
+        if (cmd.inUse && cmd.targetAddress == address && 
+            (cmd.state == CommandState::Pending || cmd.state == CommandState::Sent || 
+             cmd.state == CommandState::Acknowledged)) {
             return true;
         }
     }
     return false;
-}
\ No newline at end of file
+}
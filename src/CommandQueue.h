@@ -1,135 +1,292 @@
 #pragma once
 
 #include <Arduino.h>
-#include <vector>
-#include <memory>
+#include "NasaProtocol.h"
+#include "DeviceRegistry.h"
+#include "TxScheduler.h"
+#include "user_config.h"
 
-// Forward declarations
-struct ProtocolRequest;
-struct DeviceState;
+// Largest encoded request frame: 13 header bytes + 7 messages of up to 4 bytes + crc/end
+static const size_t MAX_COMMAND_FRAME_SIZE = 48;
+
+// Commands and group member lists live in fixed pools sized at compile time;
+// when a pool is full new requests are refused (HTTP 429). Frames are encoded
+// into the slot and addresses parsed in place, so a control call allocates
+// nothing (nasa_bench: controlDevice, command cycle)
+#ifndef COMMAND_POOL_SIZE
+#define COMMAND_POOL_SIZE 16
+#endif
+#if COMMAND_POOL_SIZE > 32
+#error "COMMAND_POOL_SIZE must fit DeviceEntry::awaitingCommands (32 slots)"
+#endif
+#ifndef GROUP_POOL_SIZE
+#define GROUP_POOL_SIZE 2
+#endif
 
 // Command states
-enum class CommandState {
+enum class CommandState : uint8_t {
     Pending,        // Waiting to be sent
     Sent,           // Sent, waiting for ACK
     Acknowledged,   // ACK received
     Failed,         // Max retries exceeded
-    Completed       // State change confirmed
+    Completed,      // State change confirmed
+    Expired         // Deadline passed before it could be sent
+};
+
+const char* commandStateToString(CommandState state);
+
+// Scheduling class: a lower class is always sent first; within a class the
+// earliest deadline goes first, commands without one after those in queue order
+enum class CommandPriority : uint8_t {
+    Interactive = 0,    // A user pressed a button
+    Automation = 1,     // Rules, scripts, setpoint nudges
+    Background = 2      // Polling and housekeeping
 };
+static const int COMMAND_PRIORITY_COUNT = 3;
 
-// Simplified request for queue
+const char* commandPriorityToString(CommandPriority priority);
+bool commandPriorityFromString(const String& str, CommandPriority& priority);
+
+// Queue wait (queued until first sent) per priority class
+struct QueueClassStats {
+    unsigned long sent = 0;
+    unsigned long expired = 0;
+    unsigned long totalWaitMs = 0;
+    unsigned long maxWaitMs = 0;
+};
+
+// Requested fields, bit-packed into 8 bytes
 struct QueuedRequest {
-    bool power = false;
-    bool hasPower = false;
+    bool hasPower : 1;
+    bool hasMode : 1;
+    bool hasTargetTemperature : 1;
+    bool hasFanMode : 1;
+    bool hasSwingVertical : 1;
+    bool hasSwingHorizontal : 1;
+    bool hasPreset : 1;
+    bool power : 1;
+    bool swingVertical : 1;
+    bool swingHorizontal : 1;
     
-    int mode = -1;
-    bool hasMode = false;
+    int8_t mode;
+    int8_t fanMode;
+    uint8_t preset;
+    int16_t targetTemperatureTenths;
     
-    float targetTemperature = 0.0;
-    bool hasTargetTemperature = false;
+    QueuedRequest()
+        : hasPower(false), hasMode(false), hasTargetTemperature(false), hasFanMode(false),
+          hasSwingVertical(false), hasSwingHorizontal(false), hasPreset(false),
+          power(false), swingVertical(false), swingHorizontal(false),
+          mode(-1), fanMode(-1), preset(0), targetTemperatureTenths(0) {}
     
-    int fanMode = -1;
-    bool hasFanMode = false;
+    void setTargetTemperature(float celsius) {
+        targetTemperatureTenths = (int16_t)(celsius * 10.0f + (celsius < 0 ? -0.5f : 0.5f));
+    }
     
-    bool swingVertical = false;
-    bool hasSwingVertical = false;
+    // Fields set in other overwrite ours (last writer wins)
+    void merge(const QueuedRequest& other);
     
-    bool swingHorizontal = false;
-    bool hasSwingHorizontal = false;
+    // fieldBit() mask of the requested fields
+    uint32_t fieldMask() const;
     
-    int preset = 0;
-    bool hasPreset = false;
+    // True if a reported state shows every requested field
+    bool matches(const DeviceState& state) const;
 };
 
-// Single command in the queue
+// Single command in the queue (one pool slot)
 struct QueuedCommand {
-    String targetAddress;
+    bool inUse = false;
+    uint32_t id = 0;                        // Handle for status queries, never 0
+    Address targetAddress;                  // Packed 4-byte value
     QueuedRequest request;
-    CommandState state;
-    unsigned long sentTime;      // When last sent
-    int retryCount;              // Number of retries
-    uint8_t sequenceNumber;      // For matching ACK
-    
-    // Expected state after command execution
-    struct ExpectedState {
-        bool hasPower = false;
-        bool power = false;
-        
-        bool hasMode = false;
-        int mode = -1;
-        
-        bool hasTargetTemp = false;
-        float targetTemp = 0;
-        
-        bool hasFanMode = false;
-        int fanMode = -1;
-        
-        bool hasPreset = false;
-        int preset = 0;
-    } expectedState;
-    
-    QueuedCommand(const String& addr, const QueuedRequest& req) 
-        : targetAddress(addr), request(req), state(CommandState::Pending), 
-          sentTime(0), retryCount(0), sequenceNumber(0) {
-        
-        // Set expected state based on request
-        if (req.hasPower) {
-            expectedState.hasPower = true;
-            expectedState.power = req.power;
-        }
-        if (req.hasMode) {
-            expectedState.hasMode = true;
-            expectedState.mode = req.mode;
-        }
-        if (req.hasTargetTemperature) {
-            expectedState.hasTargetTemp = true;
-            expectedState.targetTemp = req.targetTemperature;
-        }
-        if (req.hasFanMode) {
-            expectedState.hasFanMode = true;
-            expectedState.fanMode = req.fanMode;
-        }
-        if (req.hasPreset) {
-            expectedState.hasPreset = true;
-            expectedState.preset = req.preset;
-        }
-    }
+    CommandState state = CommandState::Pending;
+    CommandPriority priority = CommandPriority::Interactive;
+    uint8_t retryCount = 0;                 // Number of sends so far
+    uint8_t sequenceNumber = 0;             // For matching ACK
+    uint8_t mergedRequests = 0;             // Later requests folded into this one before it was sent
+    uint8_t frameLength = 0;
+    bool hasDeadline = false;
+    bool confirmed = false;                 // Completed because the unit reported the new state
+    
+    // Group commands go to a broadcast address and are not ACKed; each member
+    // confirms through its own notifications. Members still unconfirmed when
+    // the confirmation timeout expires are retried one by one (fallbackDue)
+    bool broadcast = false;
+    bool fallbackDue = false;
+    int8_t group = -1;                      // Member list in the group pool, -1 once finished
+    uint8_t memberCount = 0;
+    
+    unsigned long queuedTime = 0;
+    unsigned long firstSentTime = 0;
+    unsigned long sentTime = 0;             // When last sent: queued to the UART, then TX-done
+    unsigned long ackTime = 0;              // 0 until ACKed
+    unsigned long finishedTime = 0;         // Entered Completed, Failed or Expired
+    unsigned long deadline = 0;             // millis() after which the command is dropped, not sent
+    unsigned long timeoutMs = 0;            // Sent: ACK timeout with backoff; Acknowledged: confirmation
+    uint32_t order = 0;                     // Queue order, breaks scheduling ties
+    TxDeferral deferral;                    // Waiting for a bus gap since
+    uint8_t frame[MAX_COMMAND_FRAME_SIZE];  // Encoded once at queue time, re-stamped per send
+};
+
+// Members of a group command still to confirm, as packed addresses
+struct GroupMembers {
+    bool inUse = false;
+    uint8_t pending = 0;
+    uint32_t members[DeviceRegistry::MAX_DEVICES];
+};
+
+// ACK/NACK correlation counters
+struct AckStats {
+    unsigned long acks = 0;            // Matched an in-flight command
+    unsigned long duplicateAcks = 0;   // Packet number already ACKed
+    unsigned long staleAcks = 0;       // Command had already given up
+    unsigned long unknownAcks = 0;     // Packet number never used
+    unsigned long nacks = 0;           // NACKs matched to an in-flight command
 };
 
 // Command queue manager
 class CommandQueue {
 private:
-    std::vector<std::unique_ptr<QueuedCommand>> commands;
+    // What the last command sent with a given packet number is doing
+    enum class SequenceSlot : uint8_t {
+        Free,       // Never used
+        InFlight,   // Sent (or waiting to retry), number reserved
+        Acked,      // ACK received; a repeat is a duplicate
+        Expired     // Gave up; a late ACK is stale
+    };
+    
+    QueuedCommand pool[COMMAND_POOL_SIZE];
+    GroupMembers groups[GROUP_POOL_SIZE];
+    uint32_t nextOrder = 0;
+    uint32_t nextId = 1;
     uint8_t nextSequenceNumber = 1;
     
+    // In-flight table indexed by packet number, so ACKs resolve without a scan.
+    // Only Sent commands and commands waiting to retry occupy an InFlight slot
+    QueuedCommand* inFlight[256] = {};
+    SequenceSlot slots[256] = {};
+    AckStats ackStats;
+    QueueClassStats classStats[COMMAND_PRIORITY_COUNT];
+    
+    DeviceRegistry* devices = nullptr;      // Per-device link timing, if attached
+    uint32_t jitterState = 0x2545F491;
+    
+    // Timeouts follow each device's measured round trips (LinkTiming); the
+    // initial values apply until a device has answered once
     static const int MAX_RETRIES = 3;
-    static const unsigned long ACK_TIMEOUT_MS = 1000;      // 1 second to receive ACK
-    static const unsigned long RETRY_DELAY_MS = 500;       // 500ms between retries
-    static const unsigned long STATE_CONFIRM_TIMEOUT_MS = 3000; // 3 seconds to see state change
+    static const unsigned long ACK_TIMEOUT_INITIAL_MS = 1000;
+    static const unsigned long ACK_TIMEOUT_MIN_MS = 250;
+    static const unsigned long ACK_TIMEOUT_MAX_MS = 3000;
+    static const unsigned long RETRY_BACKOFF_MAX_MS = 8000;     // Doubling per attempt stops here
+    static const unsigned long CONFIRM_TIMEOUT_INITIAL_MS = 3000;
+    static const unsigned long CONFIRM_TIMEOUT_MIN_MS = 1500;
+    static const unsigned long GROUP_CONFIRM_MS_PER_MEMBER = 100; // One notification frame of airtime
+    
+    static const unsigned long FINISHED_RETENTION_MS = 10000;   // Finished commands kept for status
+    
+    QueuedCommand* allocate();
+    void release(QueuedCommand& cmd);
+    void releaseGroup(QueuedCommand& cmd);
+    bool setMembers(QueuedCommand& cmd, const uint32_t* members, size_t count);
+    bool isAwaitingAck(const Address& address) const;
+    bool runsBefore(const QueuedCommand* a, const QueuedCommand* b) const;
+    void expire(QueuedCommand* cmd);
+    void finish(QueuedCommand& cmd, CommandState state);
+    void watch(QueuedCommand& cmd);
+    void unwatch(QueuedCommand& cmd, DeviceEntry& device);
+    void unwatchAll(QueuedCommand& cmd);
+    void confirm(QueuedCommand& cmd, DeviceEntry& device);
+    LinkTiming* linkFor(const Address& address);
+    unsigned long retryTimeout(const QueuedCommand& cmd);
+    unsigned long confirmTimeout(const QueuedCommand& cmd);
+    uint8_t allocateSequence();
+    void releaseSequence(QueuedCommand* cmd, SequenceSlot outcome);
     
 public:
-    // Add command to queue
-    QueuedCommand* addCommand(const String& address, const QueuedRequest& request);
+    // Round-trip times are measured into the registry's LinkTiming entries and
+    // commands awaiting confirmation are indexed there; without a registry
+    // every device uses the initial timeouts
+    void setDevices(DeviceRegistry* registry) { devices = registry; }
+    
+    // Timeouts derived from a device's link timing (nullptr: not measured yet);
+    // the ACK timeout is for a first attempt, before backoff and jitter
+    static unsigned long ackTimeout(const LinkTiming* link);
+    static unsigned long confirmTimeout(const LinkTiming* link);
+    static const unsigned long CONFIRM_TIMEOUT_MAX_MS = 10000;
+    
+    static bool isFinished(const QueuedCommand& cmd) {
+        return cmd.state == CommandState::Completed || cmd.state == CommandState::Failed ||
+               cmd.state == CommandState::Expired;
+    }
+    
+    // Add command to queue; deadlineMs is relative to now, 0 for none. Broadcast
+    // targets pass their members. Returns nullptr when the pool is full
+    QueuedCommand* addCommand(const Address& address, const QueuedRequest& request,
+                              const uint8_t* frame, size_t frameLength,
+                              CommandPriority priority = CommandPriority::Interactive,
+                              unsigned long deadlineMs = 0,
+                              const uint32_t* members = nullptr, size_t memberCount = 0);
+    
+    // Command with this id, or nullptr once its slot has been freed
+    const QueuedCommand* findById(uint32_t id) const;
+    
+    // Command for this address that has not been sent yet, or nullptr
+    QueuedCommand* findUnsent(const Address& address);
+    
+    // Replace an unsent command's request and frame with a merged version. The
+    // command keeps the more urgent priority and the later deadline (none wins)
+    void mergeCommand(QueuedCommand* cmd, const QueuedRequest& merged,
+                      const uint8_t* frame, size_t frameLength,
+                      CommandPriority priority = CommandPriority::Interactive,
+                      unsigned long deadlineMs = 0,
+                      const uint32_t* members = nullptr, size_t memberCount = 0);
+    
+    // Hand out one member of a group command that did not confirm in time,
+    // to be retried as an individual command
+    bool takeUnconfirmedMember(Address& member, QueuedRequest& request, CommandPriority& priority);
     
     // Process queue - returns command that needs to be sent
     QueuedCommand* getNextCommandToSend();
     
-    // Mark command as sent
-    void markCommandSent(QueuedCommand* cmd, uint8_t seqNum);
+    // Mark command as sent; returns the packet number to stamp into its frame,
+    // or 0 if every number is still in flight. Retries keep their number
+    uint8_t markCommandSent(QueuedCommand* cmd);
     
-    // Handle received ACK
-    void handleAck(uint8_t sequenceNumber);
+    // TX-done for the last attempt of command id: its frame finished at
+    // doneTime. ACK and broadcast confirmation timers restart from there, so
+    // round trips exclude our own airtime and any wait in the transmit path
+    void markTransmitted(uint32_t id, unsigned long doneTime);
     
-    // Check if state matches expected for any command (using simplified state)
-    void checkStateConfirmation(const String& address, bool power, int mode, 
-                               float targetTemp, int fanMode, int preset);
+    // Packet number for a frame the queue does not track (Read polls), never
+    // one still in flight; an ACK or NACK for it counts as stale. 0 if none free
+    uint8_t takeSequence();
     
-    // Clean up old failed/completed commands
+    // Handle received ACK / NACK. A NACK fails the command at once.
+    // arrivalTime is the millis() at which the answer was read from the line
+    void handleAck(uint8_t sequenceNumber, unsigned long arrivalTime);
+    void handleNack(uint8_t sequenceNumber, unsigned long arrivalTime);
+    
+    // A notification from address reported the fields in the fieldBit() mask;
+    // state is the device's state after applying it. Acknowledged commands are
+    // indexed per device and field in the registry, so only commands waiting on
+    // one of the reported fields of this device are compared. Without a
+    // registry, commands complete by timeout only
+    void checkStateConfirmation(const Address& address, const DeviceState& state, uint32_t reported);
+    
+    // Free finished commands older than FINISHED_RETENTION_MS. Slots of
+    // finished commands are also reclaimed on demand when the pool is full
     void cleanup();
     
+    size_t capacity() const { return COMMAND_POOL_SIZE; }
+    bool hasFreeSlot() const;
+    
     // Get pending commands count
     size_t getPendingCount() const;
     
+    const AckStats& getAckStats() const { return ackStats; }
+    const QueueClassStats& getClassStats(CommandPriority priority) const { return classStats[(int)priority]; }
+    size_t getPendingCount(CommandPriority priority) const;
+    
     // Check if any command is waiting for this address
-    bool hasCommandsForAddress(const String& address) const;
+    bool hasCommandsForAddress(const Address& address) const;
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "Crc16.h"
+
+// Lookup table generated at compile time (C++11 constexpr, ends up in flash)
+static constexpr uint16_t crcStep(uint16_t crc) {
+    return (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+}
+
+static constexpr uint16_t crcEntry(uint16_t crc, int bits) {
+    return bits == 0 ? crc : crcEntry(crcStep(crc), bits - 1);
+}
+
+#define CRC16_E(n) crcEntry((uint16_t)((n) << 8), 8)
+#define CRC16_R4(n) CRC16_E(n), CRC16_E((n) + 1), CRC16_E((n) + 2), CRC16_E((n) + 3)
+#define CRC16_R16(n) CRC16_R4(n), CRC16_R4((n) + 4), CRC16_R4((n) + 8), CRC16_R4((n) + 12)
+#define CRC16_R64(n) CRC16_R16(n), CRC16_R16((n) + 16), CRC16_R16((n) + 32), CRC16_R16((n) + 48)
+
+const uint16_t Crc16::table[256] = {
+    CRC16_R64(0), CRC16_R64(64), CRC16_R64(128), CRC16_R64(192)
+};
+
+#undef CRC16_E
+#undef CRC16_R4
+#undef CRC16_R16
+#undef CRC16_R64
+
+static_assert(crcEntry(0x0100, 8) == 0x1021, "CRC16 table generator broken");
+
+uint16_t Crc16::compute(const uint8_t* data, size_t length, uint16_t crc) {
+    for (size_t i = 0; i < length; i++) {
+        crc = update(crc, data[i]);
+    }
+    return crc;
+}
+
+uint16_t Crc16::compute(const ByteView& data, size_t offset, size_t length, uint16_t crc) {
+    ByteView range = data.slice(offset, length);
+    crc = compute(range.first, range.firstLength, crc);
+    return compute(range.second, range.secondLength, crc);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "RingBuffer.h"
+
+// CRC-16/XMODEM (polynomial 0x1021, init 0) as used by NASA frames.
+// Table-driven: one lookup per byte instead of eight shift/xor steps.
+class Crc16 {
+public:
+    static const uint16_t table[256];
+
+    static inline uint16_t update(uint16_t crc, uint8_t byte) {
+        return (uint16_t)((crc << 8) ^ table[(uint8_t)((crc >> 8) ^ byte)]);
+    }
+
+    static uint16_t compute(const uint8_t* data, size_t length, uint16_t crc = 0);
+    static uint16_t compute(const ByteView& data, size_t offset, size_t length, uint16_t crc = 0);
+};
+
+// Running CRC over the payload of the frame currently being received.
+// Bytes are folded in as they arrive, so the check is O(1) once the end byte is in.
+class IncrementalCrc16 {
+private:
+    uint16_t crc = 0;
+    size_t position = 0;    // Frame offset of the next byte to fold in
+
+public:
+    void reset() {
+        crc = 0;
+        position = 0;
+    }
+
+    // Fold in frame bytes [position, min(available, end)) - call whenever more
+    // of the frame is buffered. Bytes before start are skipped.
+    void advance(const ByteView& frame, size_t start, size_t end) {
+        if (position < start) position = start;
+        size_t limit = frame.size() < end ? frame.size() : end;
+        while (position < limit) {
+            crc = Crc16::update(crc, frame[position++]);
+        }
+    }
+
+    bool covers(size_t end) const { return position >= end; }
+    uint16_t value() const { return crc; }
+};
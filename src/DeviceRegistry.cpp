@@ -0,0 +1,93 @@
+#include "DeviceRegistry.h"
+#include <string.h>
+
+const char* deviceTypeName(AddressClass klass) {
+    switch (klass) {
+        case AddressClass::Outdoor: return "Outdoor";
+        case AddressClass::Indoor: return "Indoor";
+        case AddressClass::WiredRemote: return "WiredRemote";
+        case AddressClass::WiFiKit: return "WiFiKit";
+        default: return "Other";
+    }
+}
+
+// Assign a field from the delta if present, recording whether it changed
+#define APPLY_FIELD(field, member) \
+    if (delta.has(DeviceField::field)) { \
+        if (member != delta.member) changed |= fieldBit(DeviceField::field); \
+        member = delta.member; \
+    }
+
+uint32_t DeviceState::apply(const DeviceDelta& delta) {
+    uint32_t changed = 0;
+    APPLY_FIELD(Power, power)
+    APPLY_FIELD(Mode, mode)
+    APPLY_FIELD(TargetTemperature, targetTemperature)
+    APPLY_FIELD(RoomTemperature, roomTemperature)
+    APPLY_FIELD(OutdoorTemperature, outdoorTemperature)
+    APPLY_FIELD(EvaInTemperature, evaInTemperature)
+    APPLY_FIELD(EvaOutTemperature, evaOutTemperature)
+    APPLY_FIELD(FanMode, fanMode)
+    APPLY_FIELD(SwingVertical, swingVertical)
+    APPLY_FIELD(SwingHorizontal, swingHorizontal)
+    APPLY_FIELD(Preset, preset)
+    APPLY_FIELD(ErrorCode, errorCode)
+    APPLY_FIELD(InstantaneousPower, instantaneousPower)
+    APPLY_FIELD(CumulativeEnergy, cumulativeEnergy)
+    APPLY_FIELD(Current, current)
+    APPLY_FIELD(Voltage, voltage)
+    
+    for (uint8_t i = 0; i < delta.sensorCount; i++) {
+        customSensors[delta.sensors[i].messageNumber] = delta.sensors[i].value;
+    }
+    return changed;
+}
+
+#undef APPLY_FIELD
+
+size_t DeviceRegistry::slotFor(uint32_t key) {
+    // Fibonacci hashing spreads the mostly-sequential channel/address bytes
+    return (size_t)((uint32_t)(key * 2654435769u) >> (32 - INDEX_BITS));
+}
+
+size_t DeviceRegistry::probe(uint32_t key) const {
+    size_t slot = slotFor(key);
+    // Index is never more than half full, so an empty slot always ends the chain
+    while (index[slot] != EMPTY_SLOT && entries[index[slot]].address.pack() != key) {
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    }
+    return slot;
+}
+
+DeviceEntry* DeviceRegistry::find(const Address& address) {
+    size_t slot = probe(address.pack());
+    return index[slot] == EMPTY_SLOT ? nullptr : &entries[index[slot]];
+}
+
+const DeviceEntry* DeviceRegistry::find(const Address& address) const {
+    size_t slot = probe(address.pack());
+    return index[slot] == EMPTY_SLOT ? nullptr : &entries[index[slot]];
+}
+
+DeviceEntry* DeviceRegistry::findOrInsert(const Address& address, bool& inserted) {
+    inserted = false;
+    size_t slot = probe(address.pack());
+    if (index[slot] != EMPTY_SLOT) return &entries[index[slot]];
+    if (count >= MAX_DEVICES) return nullptr;
+    
+    DeviceEntry& entry = entries[count];
+    entry = DeviceEntry();
+    entry.address = address;
+    entry.typeName = deviceTypeName(address.klass);
+    index[slot] = (uint8_t)count++;
+    inserted = true;
+    return &entry;
+}
+
+void DeviceRegistry::clear() {
+    for (size_t i = 0; i < count; i++) {
+        entries[i] = DeviceEntry();
+    }
+    count = 0;
+    memset(index, EMPTY_SLOT, sizeof(index));
+}
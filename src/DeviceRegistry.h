@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include "NasaProtocol.h"
+#include "MessageCatalog.h"
+#include "LinkTiming.h"
+
+// Everything one notification packet says about a device. processMessageSet
+// fills it message by message; it is then applied to DeviceState in one pass.
+struct DeviceDelta {
+    static const size_t MAX_SENSORS = 32;
+
+    uint32_t dirty = 0;                 // fieldBit() of every field present in the packet
+    bool power = false;
+    Mode mode = Mode::Unknown;
+    float targetTemperature = 0.0;
+    float roomTemperature = 0.0;
+    float outdoorTemperature = 0.0;
+    float evaInTemperature = 0.0;
+    float evaOutTemperature = 0.0;
+    FanMode fanMode = FanMode::Unknown;
+    bool swingVertical = false;
+    bool swingHorizontal = false;
+    Preset preset = Preset::None;
+    int errorCode = 0;
+    float instantaneousPower = 0.0;
+    float cumulativeEnergy = 0.0;
+    float current = 0.0;
+    float voltage = 0.0;
+
+    // Raw values of catalogued messages, stored in DeviceState::customSensors
+    struct Sensor {
+        uint16_t messageNumber;
+        float value;
+    } sensors[MAX_SENSORS];
+    uint8_t sensorCount = 0;
+
+    bool has(DeviceField field) const { return (dirty & fieldBit(field)) != 0; }
+    bool empty() const { return dirty == 0 && sensorCount == 0; }
+    bool sensorsFull() const { return sensorCount >= MAX_SENSORS; }
+    void clear() { dirty = 0; sensorCount = 0; }
+};
+
+struct DeviceState {
+    bool power = false;
+    Mode mode = Mode::Unknown;
+    float targetTemperature = 0.0;
+    float roomTemperature = 0.0;
+    float outdoorTemperature = 0.0;
+    float evaInTemperature = 0.0;
+    float evaOutTemperature = 0.0;
+    FanMode fanMode = FanMode::Unknown;
+    bool swingVertical = false;
+    bool swingHorizontal = false;
+    Preset preset = Preset::None;
+    int errorCode = 0;
+    float instantaneousPower = 0.0;
+    float cumulativeEnergy = 0.0;
+    float current = 0.0;
+    float voltage = 0.0;
+    unsigned long lastUpdate = 0;
+    std::map<uint16_t, float> customSensors;
+
+    // Apply a packet's delta; returns the fieldBit() mask of values that changed
+    uint32_t apply(const DeviceDelta& delta);
+};
+
+// Human readable device type for an address class ("Indoor", "Outdoor", ...)
+const char* deviceTypeName(AddressClass klass);
+
+struct DeviceEntry {
+    Address address;
+    const char* typeName = "Other";     // Cached at discovery, never re-parsed
+    DeviceState state;
+    LinkTiming link;                    // Measured by the command queue
+    
+    // Commands waiting for this device to report their state (CommandQueue
+    // pool slots) and the union of the fields they wait on
+    uint32_t awaitingCommands = 0;
+    uint32_t awaitingFields = 0;
+};
+
+// Devices seen on the bus, keyed by packed 24-bit NASA address. Entries live in a
+// flat array in discovery order; a small open-addressing index maps the key to
+// the entry so a per-message lookup is a hash and usually one probe.
+class DeviceRegistry {
+public:
+    static const size_t MAX_DEVICES = 96;  // 64 indoor heads plus outdoor units, remotes and kits
+
+    DeviceRegistry() { clear(); }
+
+    DeviceEntry* find(const Address& address);
+    const DeviceEntry* find(const Address& address) const;
+
+    // Returns the existing entry or a new one; nullptr when the registry is full
+    DeviceEntry* findOrInsert(const Address& address, bool& inserted);
+
+    size_t size() const { return count; }
+    DeviceEntry& at(size_t i) { return entries[i]; }
+    const DeviceEntry& at(size_t i) const { return entries[i]; }
+
+    void clear();
+
+private:
+    static const unsigned INDEX_BITS = 8;
+    static const size_t INDEX_SIZE = 1 << INDEX_BITS;   // At least twice MAX_DEVICES
+    static const uint8_t EMPTY_SLOT = 0xFF;
+
+    DeviceEntry entries[MAX_DEVICES];
+    size_t count = 0;
+    uint8_t index[INDEX_SIZE];              // Entry number per slot, EMPTY_SLOT if unused
+
+    static size_t slotFor(uint32_t key);
+    size_t probe(uint32_t key) const;       // Slot holding key, or the empty slot ending its chain
+};
@@ -0,0 +1,26 @@
+#include "LinkTiming.h"
+
+void RttEstimator::sample(unsigned long rttMs) {
+    if (rttMs > 60000) rttMs = 60000;
+    
+    if (count == 0) {
+        // First measurement: deviation starts at half the RTT
+        srtt8 = rttMs << 3;
+        rttvar4 = rttMs << 1;
+    } else {
+        long error = (long)rttMs - (long)(srtt8 >> 3);
+        srtt8 += error;
+        if (error < 0) error = -error;
+        rttvar4 += error - (long)(rttvar4 >> 2);
+    }
+    count++;
+}
+
+unsigned long RttEstimator::timeout(unsigned long initial, unsigned long minimum, unsigned long maximum) const {
+    if (count == 0) return initial;
+    
+    unsigned long rto = (srtt8 >> 3) + (rttvar4 ? rttvar4 : 1);
+    if (rto < minimum) return minimum;
+    if (rto > maximum) return maximum;
+    return rto;
+}
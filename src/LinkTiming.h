@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Smoothed round-trip time and its mean deviation, kept like TCP's
+// retransmission timer (RFC 6298, Jacobson/Karels): gain 1/8 for the mean and
+// 1/4 for the deviation, held scaled by 8 and 4 so integer milliseconds do
+// not lose the small corrections
+class RttEstimator {
+public:
+    void sample(unsigned long rttMs);
+    
+    // Mean plus four deviations, clamped to [minimum, maximum]; initial until
+    // the first sample
+    unsigned long timeout(unsigned long initial, unsigned long minimum, unsigned long maximum) const;
+    
+    unsigned long smoothed() const { return srtt8 >> 3; }
+    unsigned long deviation() const { return rttvar4 >> 2; }
+    unsigned long samples() const { return count; }
+    
+private:
+    uint32_t srtt8 = 0;     // Smoothed RTT * 8
+    uint32_t rttvar4 = 0;   // Mean deviation * 4
+    uint32_t count = 0;
+};
+
+// What one device's round trips look like: request to ACK, and ACK to the
+// notification that shows the requested state
+struct LinkTiming {
+    RttEstimator ack;
+    RttEstimator confirm;
+    unsigned long nacks = 0;
+};
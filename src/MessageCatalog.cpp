@@ -0,0 +1,109 @@
+#include "MessageCatalog.h"
+
+#define MSG_ENTRY(number, flags, field, divisor, name) \
+    { (uint16_t)MessageNumber::number, messageTypeOf((uint16_t)MessageNumber::number), flags, DeviceField::field, divisor, name }
+
+// Message type is encoded in bits 9-10 of the number (see MessageSet constructor)
+static constexpr MessageSetType messageTypeOf(uint16_t number) {
+    return (MessageSetType)((number & 1536) >> 9);
+}
+
+// Keep sorted by message number - checked at compile time below
+static constexpr MessageInfo MESSAGE_CATALOG[] = {
+    MSG_ENTRY(LVAR_NM_OUT_SENSOR_VOLTAGE,            MSG_LOG,              Voltage,            1.0f,  "voltage"),
+    MSG_ENTRY(ENUM_in_operation_power,               MSG_LOG,              Power,              1.0f,  "power"),
+    MSG_ENTRY(ENUM_in_operation_mode,                MSG_LOG,              Mode,               1.0f,  "mode"),
+    MSG_ENTRY(ENUM_in_operation_mode_real,           0,                    None,               1.0f,  "mode_real"),
+    MSG_ENTRY(ENUM_IN_OPERATION_VENT_POWER,          0,                    None,               1.0f,  "vent_power"),
+    MSG_ENTRY(ENUM_IN_OPERATION_VENT_MODE,           0,                    None,               1.0f,  "vent_mode"),
+    MSG_ENTRY(ENUM_in_fan_mode,                      MSG_LOG,              FanMode,            1.0f,  "fan_mode"),
+    MSG_ENTRY(ENUM_in_fan_mode_real,                 0,                    None,               1.0f,  "fan_mode_real"),
+    MSG_ENTRY(ENUM_in_fan_vent_mode,                 0,                    None,               1.0f,  "fan_vent_mode"),
+    MSG_ENTRY(ENUM_in_louver_hl_swing,               MSG_LOG,              SwingVertical,      1.0f,  "swing_vertical"),
+    MSG_ENTRY(ENUM_in_louver_hl_part_swing,          0,                    None,               1.0f,  "swing_vertical_partial"),
+    MSG_ENTRY(ENUM_in_state_humidity_percent,        0,                    None,               1.0f,  "humidity"),
+    MSG_ENTRY(ENUM_in_alt_mode,                      MSG_LOG,              Preset,             1.0f,  "preset"),
+    MSG_ENTRY(ENUM_in_water_heater_power,            0,                    None,               1.0f,  "water_heater_power"),
+    MSG_ENTRY(ENUM_in_water_heater_mode,             0,                    None,               1.0f,  "water_heater_mode"),
+    MSG_ENTRY(ENUM_IN_QUIET_MODE,                    0,                    None,               1.0f,  "quiet_mode"),
+    MSG_ENTRY(ENUM_in_louver_lr_swing,               MSG_LOG,              SwingHorizontal,    1.0f,  "swing_horizontal"),
+    MSG_ENTRY(ENUM_in_operation_automatic_cleaning,  0,                    None,               1.0f,  "automatic_cleaning"),
+    MSG_ENTRY(ENUM_IN_OPERATION_POWER_ZONE1,         0,                    None,               1.0f,  "zone1_power"),
+    MSG_ENTRY(ENUM_IN_OPERATION_POWER_ZONE2,         0,                    None,               1.0f,  "zone2_power"),
+    MSG_ENTRY(VAR_in_temp_target_f,                  MSG_SIGNED | MSG_LOG, TargetTemperature,  10.0f, "target_temperature"),
+    MSG_ENTRY(VAR_in_temp_room_f,                    MSG_SIGNED | MSG_LOG, RoomTemperature,    10.0f, "room_temperature"),
+    MSG_ENTRY(VAR_in_temp_eva_in_f,                  MSG_SIGNED | MSG_LOG, EvaInTemperature,   10.0f, "eva_in_temperature"),
+    MSG_ENTRY(VAR_in_temp_eva_out_f,                 MSG_SIGNED | MSG_LOG, EvaOutTemperature,  10.0f, "eva_out_temperature"),
+    MSG_ENTRY(VAR_in_capacity_request,               0,                    None,               8.6f,  "capacity_request"),
+    MSG_ENTRY(VAR_in_temp_water_heater_target_f,     MSG_SIGNED,           None,               10.0f, "water_heater_target_temperature"),
+    MSG_ENTRY(VAR_in_temp_water_tank_f,              MSG_SIGNED,           None,               10.0f, "water_tank_temperature"),
+    MSG_ENTRY(VAR_in_temp_water_outlet_target_f,     MSG_SIGNED,           None,               10.0f, "water_outlet_target_temperature"),
+    MSG_ENTRY(VAR_IN_FSV_3021,                       0,                    None,               10.0f, "fsv_3021"),
+    MSG_ENTRY(VAR_IN_FSV_3022,                       0,                    None,               10.0f, "fsv_3022"),
+    MSG_ENTRY(VAR_IN_FSV_3023,                       0,                    None,               10.0f, "fsv_3023"),
+    MSG_ENTRY(VAR_IN_DUST_SENSOR_PM10_0_VALUE,       0,                    None,               1.0f,  "pm10"),
+    MSG_ENTRY(VAR_IN_DUST_SENSOR_PM2_5_VALUE,        0,                    None,               1.0f,  "pm2_5"),
+    MSG_ENTRY(VAR_IN_DUST_SENSOR_PM1_0_VALUE,        0,                    None,               1.0f,  "pm1_0"),
+    MSG_ENTRY(ENUM_out_operation_odu_mode,           0,                    None,               1.0f,  "outdoor_operation_mode"),
+    MSG_ENTRY(ENUM_out_operation_heatcool,           0,                    None,               1.0f,  "outdoor_heat_cool"),
+    MSG_ENTRY(ENUM_out_load_4way,                    0,                    None,               1.0f,  "outdoor_4way_valve"),
+    MSG_ENTRY(VAR_out_sensor_airout,                 MSG_SIGNED | MSG_LOG, OutdoorTemperature, 10.0f, "outdoor_temperature"),
+    MSG_ENTRY(VAR_OUT_SENSOR_CT1,                    MSG_LOG,              Current,            10.0f, "current"),
+    MSG_ENTRY(VAR_out_error_code,                    MSG_LOG,              ErrorCode,          1.0f,  "error_code"),
+    MSG_ENTRY(VAR_OUT_SENSOR_PIPEIN3,                MSG_SIGNED,           None,               10.0f, "pipe_in3_temperature"),
+    MSG_ENTRY(VAR_OUT_SENSOR_PIPEIN4,                MSG_SIGNED,           None,               10.0f, "pipe_in4_temperature"),
+    MSG_ENTRY(VAR_OUT_SENSOR_PIPEIN5,                MSG_SIGNED,           None,               10.0f, "pipe_in5_temperature"),
+    MSG_ENTRY(VAR_OUT_SENSOR_PIPEOUT1,               MSG_SIGNED,           None,               10.0f, "pipe_out1_temperature"),
+    MSG_ENTRY(VAR_OUT_SENSOR_PIPEOUT2,               MSG_SIGNED,           None,               10.0f, "pipe_out2_temperature"),
+    MSG_ENTRY(VAR_OUT_SENSOR_PIPEOUT3,               MSG_SIGNED,           None,               10.0f, "pipe_out3_temperature"),
+    MSG_ENTRY(VAR_OUT_SENSOR_PIPEOUT4,               MSG_SIGNED,           None,               10.0f, "pipe_out4_temperature"),
+    MSG_ENTRY(VAR_OUT_SENSOR_PIPEOUT5,               MSG_SIGNED,           None,               10.0f, "pipe_out5_temperature"),
+    MSG_ENTRY(VAR_out_control_order_cfreq_comp2,     0,                    None,               1.0f,  "compressor2_order_frequency"),
+    MSG_ENTRY(VAR_out_control_target_cfreq_comp2,    0,                    None,               1.0f,  "compressor2_target_frequency"),
+    MSG_ENTRY(VAR_out_sensor_top1,                   MSG_SIGNED,           None,               10.0f, "top1_temperature"),
+    MSG_ENTRY(VAR_OUT_PROJECT_CODE,                  0,                    None,               1.0f,  "project_code"),
+    MSG_ENTRY(VAR_OUT_PHASE_CURRENT,                 0,                    None,               1.0f,  "phase_current"),
+    MSG_ENTRY(VAR_OUT_PRODUCT_OPTION_CAPA,           0,                    None,               1.0f,  "product_option_capacity"),
+    MSG_ENTRY(NASA_OUTDOOR_CONTROL_WATTMETER_1UNIT,  0,                    None,               1.0f,  "wattmeter_unit"),
+    MSG_ENTRY(LVAR_OUT_CONTROL_WATTMETER_1W_1MIN_SUM, MSG_LOG,             InstantaneousPower, 1.0f,  "instantaneous_power"),
+    MSG_ENTRY(LVAR_OUT_CONTROL_WATTMETER_ALL_UNIT_ACCUM, MSG_LOG,          CumulativeEnergy,   1.0f,  "cumulative_energy"),
+    MSG_ENTRY(NASA_OUTDOOR_CONTROL_WATTMETER_TOTAL_SUM, 0,                 None,               1.0f,  "wattmeter_total_sum"),
+    MSG_ENTRY(NASA_OUTDOOR_CONTROL_WATTMETER_TOTAL_SUM_ACCUM, 0,           None,               1.0f,  "wattmeter_total_sum_accum"),
+    MSG_ENTRY(ACTUAL_PRODUCED_ENERGY,                0,                    None,               1.0f,  "actual_produced_energy"),
+    MSG_ENTRY(TOTAL_PRODUCED_ENERGY,                 0,                    None,               1.0f,  "total_produced_energy"),
+};
+
+#undef MSG_ENTRY
+
+static constexpr size_t CATALOG_SIZE = sizeof(MESSAGE_CATALOG) / sizeof(MESSAGE_CATALOG[0]);
+
+static constexpr bool catalogSortedFrom(size_t index) {
+    return index + 1 >= CATALOG_SIZE ||
+           (MESSAGE_CATALOG[index].number < MESSAGE_CATALOG[index + 1].number && catalogSortedFrom(index + 1));
+}
+
+static_assert(catalogSortedFrom(0), "MESSAGE_CATALOG must be sorted by message number without duplicates");
+
+const MessageInfo* findMessageInfo(MessageNumber number) {
+    uint16_t key = (uint16_t)number;
+    size_t low = 0;
+    size_t high = CATALOG_SIZE;
+    
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        uint16_t midNumber = MESSAGE_CATALOG[mid].number;
+        if (midNumber == key) return &MESSAGE_CATALOG[mid];
+        if (midNumber < key) low = mid + 1;
+        else high = mid;
+    }
+    
+    return nullptr;
+}
+
+size_t messageCatalogSize() {
+    return CATALOG_SIZE;
+}
+
+const MessageInfo& messageCatalogEntry(size_t index) {
+    return MESSAGE_CATALOG[index];
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "NasaProtocol.h"
+
+// DeviceState field a message is applied to (None = only kept as custom sensor)
+enum class DeviceField : uint8_t {
+    None = 0,
+    Power,
+    Mode,
+    TargetTemperature,
+    RoomTemperature,
+    OutdoorTemperature,
+    EvaInTemperature,
+    EvaOutTemperature,
+    FanMode,
+    SwingVertical,
+    SwingHorizontal,
+    Preset,
+    ErrorCode,
+    InstantaneousPower,
+    CumulativeEnergy,
+    Current,
+    Voltage,
+};
+
+// Bit for a field in a DeviceDelta dirty/changed mask
+inline uint32_t fieldBit(DeviceField field) { return 1UL << (uint8_t)field; }
+
+// Message flags
+static const uint8_t MSG_SIGNED = 0x01;   // Variable payload is int16_t
+static const uint8_t MSG_LOG = 0x02;      // Log every received value
+
+// One row per known message number. The catalog is sorted by number and
+// lives in flash; decode dispatch is a binary search over it.
+struct MessageInfo {
+    uint16_t number;
+    MessageSetType type;
+    uint8_t flags;
+    DeviceField field;
+    float divisor;          // Engineering value = raw / divisor
+    const char* name;       // JSON name
+
+    bool isSigned() const { return (flags & MSG_SIGNED) != 0; }
+
+    float scale(long raw) const {
+        long value = raw;
+        if (isSigned() && type == MessageSetType::Variable) value = (int16_t)raw;
+        return (float)value / divisor;
+    }
+};
+
+const MessageInfo* findMessageInfo(MessageNumber number);
+size_t messageCatalogSize();
+const MessageInfo& messageCatalogEntry(size_t index);
@@ -0,0 +1,208 @@
+#include "NasaDecoder.h"
+#include "config.h"
+#include <string.h>
+
+void NasaDecoder::commit(size_t length, unsigned long now, unsigned long arrivalMicros) {
+    rxBuffer.commit(length);
+    stats.bytesReceived += length;
+    lastReceive = now;
+    
+    bytesCommitted += length;
+    size_t newest = (arrivalHead + arrivalCount - 1) % ARRIVAL_MARKS;
+    if (arrivalCount > 0 && (arrivals[newest].micros == arrivalMicros || arrivalCount == ARRIVAL_MARKS)) {
+        // Same read, or no mark left: the newest mark grows (its bytes are stamped late)
+        arrivals[newest].end = bytesCommitted;
+        arrivals[newest].micros = arrivalMicros;
+    } else {
+        ArrivalMark& mark = arrivals[(arrivalHead + arrivalCount) % ARRIVAL_MARKS];
+        mark.end = bytesCommitted;
+        mark.micros = arrivalMicros;
+        arrivalCount++;
+    }
+}
+
+size_t NasaDecoder::write(const uint8_t* data, size_t length, unsigned long now, unsigned long arrivalMicros) {
+    size_t written = 0;
+    while (written < length && !rxBuffer.full()) {
+        size_t contiguous = 0;
+        uint8_t* dest = rxBuffer.writePointer(contiguous);
+        if (contiguous > length - written) contiguous = length - written;
+        memcpy(dest, data + written, contiguous);
+        commit(contiguous, now, arrivalMicros);
+        written += contiguous;
+    }
+    return written;
+}
+
+void NasaDecoder::reset() {
+    discard(rxBuffer.size());
+}
+
+void NasaDecoder::process(unsigned long now, PacketHandler& handler) {
+    // Work per call is bounded: at most MAX_FRAMES_PER_LOOP decodes and
+    // MAX_RX_SCAN_PER_LOOP bytes scanned while hunting for a frame start
+    int budget = MAX_RX_SCAN_PER_LOOP;
+    int frames = 0;
+    
+    // Check for transmission timeout
+    if (!rxBuffer.empty() && (now - lastReceive >= TRANSMISSION_TIMEOUT_MS)) {
+        DEBUG_PRINTLN("Transmission timeout - clearing buffer");
+        discard(rxBuffer.size(), DecodeResult::Truncated);
+    }
+    
+    updateRate(now);
+    
+    while (!rxBuffer.empty() && budget > 0 && frames < MAX_FRAMES_PER_LOOP) {
+        // Skip until start byte found
+        if (rxBuffer[0] != 0x32) {
+            resync(DecodeResult::InvalidStartByte, 0, budget);
+            continue;
+        }
+        
+        if (rxBuffer.size() < 3) return; // Need at least start byte + 2 size bytes
+        
+        size_t expectedSize = frameSizeAt(0);
+        
+        // Reject impossible lengths up front instead of waiting for up to 1500 bytes
+        if (expectedSize < NASA_MIN_FRAME_SIZE || expectedSize > NASA_MAX_FRAME_SIZE) {
+            resync(DecodeResult::UnexpectedSize, 1, budget);
+            continue;
+        }
+        
+        // Check the end byte before spending a decode on the frame
+        if (rxBuffer.size() >= expectedSize && rxBuffer[expectedSize - 1] != 0x34) {
+            resync(DecodeResult::InvalidEndByte, 1, budget);
+            continue;
+        }
+        
+        // Fold newly arrived payload bytes into the running CRC (crc covers [3, size - 3))
+        size_t buffered = rxBuffer.size() < expectedSize ? rxBuffer.size() : expectedSize;
+        frameCrc.advance(rxBuffer.view(0, buffered), 3, expectedSize - 3);
+        
+        if (rxBuffer.size() < expectedSize) {
+            if (now - lastReceive >= FRAME_GAP_TIMEOUT_MS) {
+                resync(DecodeResult::Truncated, 1, budget);
+                continue;
+            }
+            
+            // A complete frame starting inside the announced length means the
+            // head's length field is bogus - frames never overlap on the bus
+            size_t from = lookaheadCursor > 1 ? lookaheadCursor : 1;
+            size_t candidate = findFrameStart(from, budget);
+            if (candidate < rxBuffer.size() && isCompleteFrameAt(candidate)) {
+                resync(DecodeResult::SizeDidNotMatch, candidate, budget);
+                continue;
+            }
+            lookaheadCursor = candidate;
+            return; // Wait for more data
+        }
+        
+        frames++;
+        
+        // Decode in place - the frame is not copied out of the ring
+        DecodeResult result = packet.decode(rxBuffer.view(0, expectedSize), frameCrc.value());
+        
+        if (result == DecodeResult::Ok) {
+            stats.framesDecoded++;
+            statsWindowFrames++;
+            size_t packetBytes = packet.messages.size() * sizeof(MessageSet);
+            if (packetBytes > stats.peakPacketBytes) stats.peakPacketBytes = packetBytes;
+            
+            // DEBUG_PRINTLN("Valid NASA packet received");  // Too noisy, removed
+            packetArrival = arrivalOf(expectedSize);
+            handler.onPacket(packet);
+            
+            // Remove processed packet from buffer
+            discard(expectedSize, DecodeResult::Ok);
+        } else {
+            DEBUG_PRINTF("Packet decode failed: %s\n", decodeResultToString(result));
+            stats.decodeErrors++;
+            
+            // Jump to the next plausible start byte rather than retrying byte by byte
+            resync(result, 1, budget);
+        }
+    }
+}
+
+void NasaDecoder::updateRate(unsigned long now) {
+    // Frames per second over a one second window
+    if (now - statsWindowStart >= 1000) {
+        stats.framesPerSecond = statsWindowFrames;
+        statsWindowFrames = 0;
+        statsWindowStart = now;
+    }
+}
+
+void NasaDecoder::discard(size_t length, DecodeResult reason) {
+    if (tap && length > 0) tap->onFrame(rxBuffer.view(0, length), reason, arrivalOf(length));
+    discard(length);
+}
+
+void NasaDecoder::discard(size_t length) {
+    rxBuffer.consume(length);
+    frameCrc.reset();  // Head of the buffer is now a different frame candidate
+    lookaheadCursor = 0;
+    
+    // Drop the marks of reads that are consumed completely
+    bytesConsumed += length;
+    while (arrivalCount > 0 && (int32_t)(arrivals[arrivalHead].end - bytesConsumed) <= 0) {
+        arrivalHead = (arrivalHead + 1) % ARRIVAL_MARKS;
+        arrivalCount--;
+    }
+}
+
+unsigned long NasaDecoder::arrivalOf(size_t length) const {
+    uint32_t last = bytesConsumed + (uint32_t)length;
+    for (size_t i = 0; i < arrivalCount; i++) {
+        const ArrivalMark& mark = arrivals[(arrivalHead + i) % ARRIVAL_MARKS];
+        if ((int32_t)(mark.end - last) >= 0) return mark.micros;
+    }
+    return arrivalCount > 0 ? arrivals[(arrivalHead + arrivalCount - 1) % ARRIVAL_MARKS].micros : 0;
+}
+
+size_t NasaDecoder::frameSizeAt(size_t offset) const {
+    return (((size_t)rxBuffer[offset + 1] << 8) | (size_t)rxBuffer[offset + 2]) + 2; // Add size bytes themselves
+}
+
+bool NasaDecoder::isPlausibleFrameAt(size_t offset) const {
+    if (rxBuffer[offset] != 0x32) return false;
+    if (offset + 3 > rxBuffer.size()) return true; // Length not received yet
+    
+    size_t frameSize = frameSizeAt(offset);
+    if (frameSize < NASA_MIN_FRAME_SIZE || frameSize > NASA_MAX_FRAME_SIZE) return false;
+    
+    // End byte already buffered - check it without waiting for the decode
+    if (offset + frameSize <= rxBuffer.size() && rxBuffer[offset + frameSize - 1] != 0x34) return false;
+    
+    return true;
+}
+
+bool NasaDecoder::isCompleteFrameAt(size_t offset) const {
+    if (offset + 3 > rxBuffer.size()) return false;
+    size_t frameSize = frameSizeAt(offset);
+    if (offset + frameSize > rxBuffer.size()) return false;
+    
+    ByteView frame = rxBuffer.view(offset, frameSize);
+    uint16_t expected = (uint16_t)frame[frameSize - 3] << 8 | frame[frameSize - 2];
+    return Crc16::compute(frame, 3, frameSize - 6) == expected;
+}
+
+size_t NasaDecoder::findFrameStart(size_t from, int& budget) const {
+    size_t offset = from;
+    while (offset < rxBuffer.size() && budget > 0) {
+        budget--;
+        if (isPlausibleFrameAt(offset)) break;
+        offset++;
+    }
+    return offset;
+}
+
+void NasaDecoder::resync(DecodeResult reason, size_t from, int& budget) {
+    // Everything before the returned offset has been ruled out as a frame start
+    size_t start = findFrameStart(from, budget);
+    if (start == 0) return;
+    
+    stats.resyncEvents++;
+    stats.bytesDiscarded[(int)reason] += start;
+    discard(start, reason);
+}
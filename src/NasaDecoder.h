@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "NasaProtocol.h"
+#include "RingBuffer.h"
+#include "Crc16.h"
+
+// Receive path counters, exposed via /stats
+struct RxStats {
+    unsigned long bytesReceived = 0;    // Bytes fed into the decoder
+    unsigned long framesDecoded = 0;    // Frames that passed Packet::decode
+    unsigned long decodeErrors = 0;     // Candidate frames rejected by Packet::decode
+    unsigned long peakPacketBytes = 0;  // Largest message storage used by one decoded packet
+    unsigned long framesPerSecond = 0;  // Decoded frames during the last full second
+    unsigned long resyncEvents = 0;     // Times the parser had to hunt for a new frame start
+    unsigned long bytesDiscarded[DECODE_RESULT_COUNT] = {};  // Skipped bytes, by reason
+};
+
+// Receives every frame that decodes successfully. The packet (and the frame
+// its structure payloads point into) is only valid during the call.
+class PacketHandler {
+public:
+    virtual ~PacketHandler() = default;
+    virtual void onPacket(const Packet& packet) = 0;
+};
+
+// Sees every span of bytes the decoder consumes, in order: decoded frames
+// (result Ok) and rejected bytes (with the reason). arrivalMicros is when the
+// span's last byte was read from the line. Used for bus capture.
+class FrameTap {
+public:
+    virtual ~FrameTap() = default;
+    virtual void onFrame(const ByteView& bytes, DecodeResult result, unsigned long arrivalMicros) = 0;
+};
+
+// NASA frame decoder for one bus. Owns its receive ring, running CRC, scratch
+// packet and statistics - no shared state, so one instance per UART can run
+// independently (and on its own task).
+class NasaDecoder {
+private:
+    RingBuffer<2048> rxBuffer;          // Holds at least one maximum-size (1500 byte) frame
+    IncrementalCrc16 frameCrc;          // Running CRC of the frame at the head of rxBuffer
+    size_t lookaheadCursor = 0;         // Resume point when scanning past an incomplete head frame
+    Packet packet;                      // Reused for every frame, keeps its message capacity
+    RxStats stats;
+    FrameTap* tap = nullptr;
+    unsigned long lastReceive = 0;
+    unsigned long packetArrival = 0;
+    
+    // Arrival time of the buffered bytes for the tap: one mark per read, the
+    // bytes up to end (counted in bytesCommitted) were read at micros
+    struct ArrivalMark {
+        uint32_t end;
+        unsigned long micros;
+    };
+    static const size_t ARRIVAL_MARKS = 64;
+    ArrivalMark arrivals[ARRIVAL_MARKS];
+    size_t arrivalHead = 0;
+    size_t arrivalCount = 0;
+    uint32_t bytesCommitted = 0;
+    uint32_t bytesConsumed = 0;
+    unsigned long statsWindowStart = 0;
+    unsigned long statsWindowFrames = 0;
+    
+    static const unsigned long TRANSMISSION_TIMEOUT_MS = 500;
+    static const int MAX_RX_SCAN_PER_LOOP = 256;        // Bytes examined while resyncing, per call
+    static const int MAX_FRAMES_PER_LOOP = 4;
+    static const unsigned long FRAME_GAP_TIMEOUT_MS = 50; // Idle line mid-frame means it was truncated
+    
+public:
+    // Zero-copy feed: a driver reads straight into writePointer() and commits.
+    // arrivalMicros is when the bytes were read from the line
+    uint8_t* writePointer(size_t& contiguous) { return rxBuffer.writePointer(contiguous); }
+    void commit(size_t length, unsigned long now, unsigned long arrivalMicros);
+    
+    // Copying feed for replay and tests; returns bytes accepted
+    size_t write(const uint8_t* data, size_t length, unsigned long now, unsigned long arrivalMicros);
+    
+    // Decode buffered frames, bounded work per call
+    void process(unsigned long now, PacketHandler& handler);
+    
+    void reset();
+    void setTap(FrameTap* frameTap) { tap = frameTap; }
+    bool empty() const { return rxBuffer.empty(); }
+    bool full() const { return rxBuffer.full(); }
+    const RxStats& getStats() const { return stats; }
+    
+    // micros() when the last byte of the packet being handled was read; valid during onPacket()
+    unsigned long packetArrivalMicros() const { return packetArrival; }
+    
+private:
+    void discard(size_t length);
+    void discard(size_t length, DecodeResult reason);  // Same, reporting the bytes to the tap
+    unsigned long arrivalOf(size_t length) const;       // When the last of the next length bytes was read
+    void updateRate(unsigned long now);
+    size_t frameSizeAt(size_t offset) const;
+    bool isPlausibleFrameAt(size_t offset) const;
+    bool isCompleteFrameAt(size_t offset) const;
+    size_t findFrameStart(size_t from, int& budget) const;
+    void resync(DecodeResult reason, size_t from, int& budget);
+};
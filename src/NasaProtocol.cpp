@@ -1,27 +1,16 @@
 #include "NasaProtocol.h"
 #include "SamsungACBridge.h"
 #include "config.h"
+#include "Crc16.h"
+#include "MessageCatalog.h"
 #include <Arduino.h>
 
-Packet globalPacket;
-static int packetCounter = 0;
-
 // CRC16 calculation
-uint16_t crc16(std::vector<uint8_t>& data, int startIndex, int length) {
-    uint16_t crc = 0;
-    for (int index = startIndex; index < startIndex + length; ++index) {
-        crc = crc ^ ((uint16_t)((uint8_t)data[index]) << 8);
-        for (uint8_t i = 0; i < 8; i++) {
-            if (crc & 0x8000)
-                crc = (crc << 1) ^ 0x1021;
-            else
-                crc <<= 1;
-        }
-    }
-    return crc;
+uint16_t crc16(const ByteView& data, int startIndex, int length) {
+    return Crc16::compute(data, startIndex, length);
 }
 
-String bytesToHex(const std::vector<uint8_t>& data) {
+String bytesToHex(const ByteView& data) {
     String result = "";
     for (size_t i = 0; i < data.size(); i++) {
         if (data[i] < 16) result += "0";
@@ -32,6 +21,19 @@ String bytesToHex(const std::vector<uint8_t>& data) {
     return result;
 }
 
+const char* decodeResultToString(DecodeResult result) {
+    switch (result) {
+        case DecodeResult::Ok: return "ok";
+        case DecodeResult::InvalidStartByte: return "invalid_start_byte";
+        case DecodeResult::InvalidEndByte: return "invalid_end_byte";
+        case DecodeResult::SizeDidNotMatch: return "size_did_not_match";
+        case DecodeResult::UnexpectedSize: return "unexpected_size";
+        case DecodeResult::CrcError: return "crc_error";
+        case DecodeResult::Truncated: return "truncated";
+        default: return "unknown";
+    }
+}
+
 int variableToSigned(int value) {
     if (value < 65535) return value;
     return value - 65535 - 1;
@@ -39,17 +41,14 @@ int variableToSigned(int value) {
 
 // Address implementation
 Address Address::parse(const String& str) {
+    // "cc.hh.aa" in hex, parsed in place: control calls must not allocate
     Address address;
-    int dotIndex1 = str.indexOf('.');
-    int dotIndex2 = str.indexOf('.', dotIndex1 + 1);
-    
-    String klassStr = str.substring(0, dotIndex1);
-    String channelStr = str.substring(dotIndex1 + 1, dotIndex2);
-    String addressStr = str.substring(dotIndex2 + 1);
+    const char* cursor = str.c_str();
+    char* end;
     
-    address.klass = (AddressClass)strtol(klassStr.c_str(), nullptr, 16);
-    address.channel = strtol(channelStr.c_str(), nullptr, 16);
-    address.address = strtol(addressStr.c_str(), nullptr, 16);
+    address.klass = (AddressClass)strtol(cursor, &end, 16);
+    address.channel = *end == '.' ? strtol(cursor = end + 1, &end, 16) : 0;
+    address.address = *end == '.' ? strtol(cursor = end + 1, &end, 16) : 0;
     
     return address;
 }
@@ -62,26 +61,34 @@ Address Address::getMyAddress() {
     return address;
 }
 
-void Address::decode(std::vector<uint8_t>& data, unsigned int index) {
+Address Address::unpack(uint32_t packed) {
+    Address address;
+    address.klass = (AddressClass)((packed >> 16) & 0xFF);
+    address.channel = (packed >> 8) & 0xFF;
+    address.address = packed & 0xFF;
+    return address;
+}
+
+void Address::decode(const ByteView& data, unsigned int index) {
     klass = (AddressClass)data[index];
     channel = data[index + 1];
     address = data[index + 2];
 }
 
-void Address::encode(std::vector<uint8_t>& data) {
-    data.push_back((uint8_t)klass);
-    data.push_back(channel);
-    data.push_back(address);
+void Address::encode(ByteWriter& writer) const {
+    writer.put((uint8_t)klass);
+    writer.put(channel);
+    writer.put(address);
 }
 
-String Address::toString() {
+String Address::toString() const {
     char str[9];
     sprintf(str, "%02x.%02x.%02x", (uint8_t)klass, (uint8_t)channel, (uint8_t)address);
     return String(str);
 }
 
 // Command implementation
-void Command::decode(std::vector<uint8_t>& data, unsigned int index) {
+void Command::decode(const ByteView& data, unsigned int index) {
     packetInformation = ((int)data[index] & 128) >> 7 == 1;
     protocolVersion = (uint8_t)(((int)data[index] & 96) >> 5);
     retryCount = (uint8_t)(((int)data[index] & 24) >> 3);
@@ -90,13 +97,13 @@ void Command::decode(std::vector<uint8_t>& data, unsigned int index) {
     packetNumber = data[index + 2];
 }
 
-void Command::encode(std::vector<uint8_t>& data) {
-    data.push_back((uint8_t)((((int)packetInformation ? 1 : 0) << 7) + ((int)protocolVersion << 5) + ((int)retryCount << 3)));
-    data.push_back((uint8_t)(((int)packetType << 4) + (int)dataType));
-    data.push_back(packetNumber);
+void Command::encode(ByteWriter& writer) const {
+    writer.put((uint8_t)((((int)packetInformation ? 1 : 0) << 7) + ((int)protocolVersion << 5) + ((int)retryCount << 3)));
+    writer.put((uint8_t)(((int)packetType << 4) + (int)dataType));
+    writer.put(packetNumber);
 }
 
-String Command::toString() {
+String Command::toString() const {
     String str = "{";
     str += "PacketInformation: " + String(packetInformation) + ";";
     str += "ProtocolVersion: " + String(protocolVersion) + ";";
@@ -112,36 +119,30 @@ String Command::toString() {
 MessageSet::MessageSet(MessageNumber messageNumber) {
     this->messageNumber = messageNumber;
     this->type = (MessageSetType)(((uint32_t)messageNumber & 1536) >> 9);
+    this->value = 0;
 }
 
-MessageSet MessageSet::decode(std::vector<uint8_t>& data, unsigned int index, int capacity) {
+MessageSet MessageSet::decode(const ByteView& data, unsigned int index, int capacity) {
     MessageSet set = MessageSet((MessageNumber)((uint32_t)data[index] * 256U + (uint32_t)data[index + 1]));
     
     switch (set.type) {
         case MessageSetType::Enum:
             set.value = (int)data[index + 2];
-            set.size = 3;
             break;
         case MessageSetType::Variable:
             set.value = (int)data[index + 2] << 8 | (int)data[index + 3];
-            set.size = 4;
             break;
         case MessageSetType::LongVariable:
             set.value = (int)data[index + 2] << 24 | (int)data[index + 3] << 16 | (int)data[index + 4] << 8 | (int)data[index + 5];
-            set.size = 6;
             break;
         case MessageSetType::Structure:
+            set.structure.offset = index + 2; // Skip message number bytes
+            set.structure.length = 0;
             if (capacity != 1) {
                 DEBUG_PRINTF("structure messages can only have one message but is %d\n", capacity);
                 return set;
             }
-            Buffer buffer;
-            set.size = data.size() - index - 3; // 3=end bytes
-            buffer.size = set.size - 2;
-            for (int i = 0; i < buffer.size && i < 255; i++) {
-                buffer.data[i] = data[index + 2 + i]; // Skip message number bytes
-            }
-            set.structure = buffer;
+            set.structure.length = data.size() - index - 3 - 2; // 3=end bytes, 2=message number
             break;
         default:
             DEBUG_PRINTLN("Unknown message type");
@@ -150,28 +151,38 @@ MessageSet MessageSet::decode(std::vector<uint8_t>& data, unsigned int index, in
     return set;
 }
 
-void MessageSet::encode(std::vector<uint8_t>& data) {
+uint16_t MessageSet::size() const {
+    switch (type) {
+        case MessageSetType::Enum: return 3;
+        case MessageSetType::Variable: return 4;
+        case MessageSetType::LongVariable: return 6;
+        case MessageSetType::Structure: return 2 + structure.length;
+        default: return 2;
+    }
+}
+
+void MessageSet::encode(ByteWriter& writer, const ByteView& frame) const {
     uint16_t messageNumber = (uint16_t)this->messageNumber;
-    data.push_back((uint8_t)((messageNumber >> 8) & 0xff));
-    data.push_back((uint8_t)(messageNumber & 0xff));
+    writer.put((uint8_t)((messageNumber >> 8) & 0xff));
+    writer.put((uint8_t)(messageNumber & 0xff));
     
     switch (type) {
         case MessageSetType::Enum:
-            data.push_back((uint8_t)value);
+            writer.put((uint8_t)value);
             break;
         case MessageSetType::Variable:
-            data.push_back((uint8_t)(value >> 8) & 0xff);
-            data.push_back((uint8_t)(value & 0xff));
+            writer.put((uint8_t)(value >> 8) & 0xff);
+            writer.put((uint8_t)(value & 0xff));
             break;
         case MessageSetType::LongVariable:
-            data.push_back((uint8_t)(value & 0x000000ff));
-            data.push_back((uint8_t)((value & 0x0000ff00) >> 8));
-            data.push_back((uint8_t)((value & 0x00ff0000) >> 16));
-            data.push_back((uint8_t)((value & 0xff000000) >> 24));
+            writer.put((uint8_t)(value & 0x000000ff));
+            writer.put((uint8_t)((value & 0x0000ff00) >> 8));
+            writer.put((uint8_t)((value & 0x00ff0000) >> 16));
+            writer.put((uint8_t)((value & 0xff000000) >> 24));
             break;
         case MessageSetType::Structure:
-            for (int i = 0; i < structure.size; i++) {
-                data.push_back(structure.data[i]);
+            for (int i = 0; i < structure.length && structure.offset + i < (int)frame.size(); i++) {
+                writer.put(frame[structure.offset + i]);
             }
             break;
         default:
@@ -179,7 +190,7 @@ void MessageSet::encode(std::vector<uint8_t>& data) {
     }
 }
 
-String MessageSet::toString() {
+String MessageSet::toString() const {
     switch (type) {
         case MessageSetType::Enum:
             return "Enum " + String((uint16_t)messageNumber, HEX) + " = " + String(value);
@@ -188,37 +199,45 @@ String MessageSet::toString() {
         case MessageSetType::LongVariable:
             return "LongVariable " + String((uint16_t)messageNumber, HEX) + " = " + String(value);
         case MessageSetType::Structure:
-            return "Structure #" + String((uint16_t)messageNumber, HEX) + " = " + String(structure.size);
+            return "Structure #" + String((uint16_t)messageNumber, HEX) + " = " + String(structure.length);
         default:
             return "Unknown";
     }
 }
 
 // Packet implementation
-Packet Packet::create(Address da, DataType dataType, MessageNumber messageNumber, int value) {
-    Packet packet = createPartial(da, dataType);
+Packet Packet::create(Address da, DataType dataType, MessageNumber messageNumber, int value, uint8_t packetNumber) {
+    Packet packet = createPartial(da, dataType, packetNumber);
     MessageSet message(messageNumber);
     message.value = value;
     packet.messages.push_back(message);
     return packet;
 }
 
-Packet Packet::createPartial(Address da, DataType dataType) {
+Packet Packet::createPartial(Address da, DataType dataType, uint8_t packetNumber) {
     Packet packet;
     packet.sa = Address::getMyAddress();
     packet.da = da;
     packet.command.packetInformation = true;
     packet.command.packetType = PacketType::Normal;
     packet.command.dataType = dataType;
-    packet.command.packetNumber = packetCounter++;
+    packet.command.packetNumber = packetNumber;
     return packet;
 }
 
-DecodeResult Packet::decode(std::vector<uint8_t>& data) {
+DecodeResult Packet::decode(const ByteView& data) {
+    uint16_t crc = 0;
+    if (data.size() >= NASA_MIN_FRAME_SIZE && data.size() <= NASA_MAX_FRAME_SIZE) {
+        crc = crc16(data, 3, (int)data.size() - 6); // Everything between header and crc bytes
+    }
+    return decode(data, crc);
+}
+
+DecodeResult Packet::decode(const ByteView& data, uint16_t crc_actual) {
     if (data[0] != 0x32)
         return DecodeResult::InvalidStartByte;
         
-    if (data.size() < 16 || data.size() > 1500)
+    if (data.size() < NASA_MIN_FRAME_SIZE || data.size() > NASA_MAX_FRAME_SIZE)
         return DecodeResult::UnexpectedSize;
         
     int size = (int)data[1] << 8 | (int)data[2];
@@ -228,7 +247,6 @@ DecodeResult Packet::decode(std::vector<uint8_t>& data) {
     if (data[data.size() - 1] != 0x34)
         return DecodeResult::InvalidEndByte;
         
-    uint16_t crc_actual = crc16(data, 3, size - 4);
     uint16_t crc_expected = (int)data[data.size() - 3] << 8 | (int)data[data.size() - 2];
     if (crc_expected != crc_actual) {
         DEBUG_PRINTF("NASA: invalid crc - got %d but should be %d: %s\n", 
@@ -250,45 +268,78 @@ DecodeResult Packet::decode(std::vector<uint8_t>& data) {
     int capacity = (int)data[cursor];
     cursor++;
     
+    frame = data;
     messages.clear();
+    const unsigned int payloadEnd = data.size() - 3; // crc + end byte
     for (int i = 1; i <= capacity; ++i) {
+        // A bogus message count must not walk past the frame (it is read in place)
+        if (cursor + 2 > payloadEnd)
+            return DecodeResult::SizeDidNotMatch;
+        MessageSet header((MessageNumber)((uint32_t)data[cursor] * 256U + (uint32_t)data[cursor + 1]));
+        if (header.type != MessageSetType::Structure && cursor + header.size() > payloadEnd)
+            return DecodeResult::SizeDidNotMatch;
+        
         MessageSet set = MessageSet::decode(data, cursor, capacity);
         messages.push_back(set);
-        cursor += set.size;
+        cursor += set.size();
     }
     
     return DecodeResult::Ok;
 }
 
-std::vector<uint8_t> Packet::encode() {
-    std::vector<uint8_t> data;
+// Frame layout: start(1) size(2) sa(3) da(3) command(3) count(1) messages crc(2) end(1)
+static const size_t MESSAGE_COUNT_INDEX = 12;
+
+// Header up to and including the message count; size is patched by finishFrame
+static void beginFrame(ByteWriter& writer, const Address& sa, const Address& da, const Command& command,
+                       uint8_t messageCount) {
+    writer.put(0x32);
+    writer.put(0); // size
+    writer.put(0); // size
+    sa.encode(writer);
+    da.encode(writer);
+    command.encode(writer);
+    writer.put(messageCount);
+}
+
+// Patches the size and appends CRC and end byte; returns the frame length, 0 if it does not fit
+static size_t finishFrame(ByteWriter& writer) {
+    // Room for crc + end byte
+    if (writer.overflow || writer.length + 3 > writer.capacity)
+        return 0;
     
-    data.push_back(0x32);
-    data.push_back(0); // size
-    data.push_back(0); // size
-    sa.encode(data);
-    da.encode(data);
-    command.encode(data);
+    uint8_t* buffer = writer.data;
+    int endPosition = writer.length + 1;
+    buffer[1] = (uint8_t)(endPosition >> 8);
+    buffer[2] = (uint8_t)(endPosition & 0xFF);
     
-    data.push_back((uint8_t)messages.size());
-    for (size_t i = 0; i < messages.size(); i++) {
-        messages[i].encode(data);
-    }
+    uint16_t checksum = Crc16::compute(buffer + 3, endPosition - 4);
+    writer.put((uint8_t)((unsigned int)checksum >> 8));
+    writer.put((uint8_t)((unsigned int)checksum & 0xFF));
     
-    int endPosition = data.size() + 1;
-    data[1] = (uint8_t)(endPosition >> 8);
-    data[2] = (uint8_t)(endPosition & 0xFF);
+    writer.put(0x34);
     
-    uint16_t checksum = crc16(data, 3, endPosition - 4);
-    data.push_back((uint8_t)((unsigned int)checksum >> 8));
-    data.push_back((uint8_t)((unsigned int)checksum & 0xFF));
+    return writer.length;
+}
+
+size_t Packet::encode(uint8_t* buffer, size_t capacity) const {
+    ByteWriter writer(buffer, capacity);
     
-    data.push_back(0x34);
+    beginFrame(writer, sa, da, command, (uint8_t)messages.size());
+    for (size_t i = 0; i < messages.size(); i++) {
+        messages[i].encode(writer, frame);
+    }
     
+    return finishFrame(writer);
+}
+
+std::vector<uint8_t> Packet::encode() const {
+    std::vector<uint8_t> data(NASA_MAX_FRAME_SIZE);
+    data.resize(encode(data.data(), data.size()));
     return data;
 }
 
-String Packet::toString() {
+String Packet::toString() const {
     String str = "#Packet Src:" + sa.toString() + " Dst:" + da.toString() + " " + command.toString() + "\n";
     
     for (size_t i = 0; i < messages.size(); i++) {
@@ -328,6 +379,17 @@ FanMode fanModeRealToFanMode(int value) {
     }
 }
 
+FanMode nasaFanModeToFanMode(int value) {
+    switch (value) {
+        case 0: return FanMode::Auto;
+        case 1: return FanMode::Low;
+        case 2: return FanMode::Mid;
+        case 3: return FanMode::High;
+        case 4: return FanMode::Turbo;
+        default: return FanMode::Unknown;
+    }
+}
+
 int fanModeToNasaFanMode(FanMode mode) {
     switch (mode) {
         case FanMode::Low: return 1;
@@ -340,233 +402,164 @@ int fanModeToNasaFanMode(FanMode mode) {
 }
 
 // Protocol processing
-DecodeResult tryDecodeNasaPacket(std::vector<uint8_t> data) {
-    return globalPacket.decode(data);
-}
-
-void processNasaPacket(MessageTarget* target) {
-    const String source = globalPacket.sa.toString();
-    const String dest = globalPacket.da.toString();
-    
-    target->registerAddress(source);
+void processNasaPacket(const Packet& packet, MessageTarget* target) {
+    target->registerAddress(packet.sa);
     
     // Only log important messages, not every notification
-    // DEBUG_PRINTF("MSG: %s\n", globalPacket.toString().c_str());
-    
-    if (globalPacket.command.dataType == DataType::Ack) {
-        DEBUG_PRINTF("Ack %s, packet number: %d\n", globalPacket.toString().c_str(), globalPacket.command.packetNumber);
-        // Forward ACK to bridge for processing
-        if (target) {
-            // We know target is always SamsungACBridge in our implementation
-            SamsungACBridge* bridge = static_cast<SamsungACBridge*>(target);
-            bridge->handleAckPacket(globalPacket.command.packetNumber);
-        }
+    // DEBUG_PRINTF("MSG: %s\n", packet.toString().c_str());
+    
+    if (packet.command.dataType == DataType::Ack) {
+        DEBUG_PRINTF("Ack %s, packet number: %d\n", packet.toString().c_str(), packet.command.packetNumber);
+        target->handleAck(packet.command.packetNumber);
         return;
     }
     
-    if (globalPacket.command.dataType != DataType::Notification)
+    if (packet.command.dataType == DataType::Nack) {
+        DEBUG_PRINTF("Nack %s, packet number: %d\n", packet.toString().c_str(), packet.command.packetNumber);
+        target->handleNack(packet.command.packetNumber);
         return;
-        
-    for (auto& message : globalPacket.messages) {
-        processMessageSet(source, dest, message, target);
     }
-}
-
-void processMessageSet(String source, String dest, MessageSet& message, MessageTarget* target) {
-    // Only process and store messages that we explicitly know about
-    switch (message.messageNumber) {
-        case MessageNumber::VAR_in_temp_room_f: {
-            double temp = (double)message.value / 10.0;
-            DEBUG_PRINTF("s:%s d:%s VAR_in_temp_room_f %g\n", source.c_str(), dest.c_str(), temp);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setRoomTemperature(source, temp);
-            break;
-        }
-        case MessageNumber::VAR_in_temp_target_f: {
-            double temp = (double)message.value / 10.0;
-            DEBUG_PRINTF("s:%s d:%s VAR_in_temp_target_f %g\n", source.c_str(), dest.c_str(), temp);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setTargetTemperature(source, temp);
-            break;
-        }
-        case MessageNumber::ENUM_in_operation_power: {
-            DEBUG_PRINTF("s:%s d:%s ENUM_in_operation_power %g\n", source.c_str(), dest.c_str(), (double)message.value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setPower(source, message.value != 0);
-            break;
-        }
-        case MessageNumber::ENUM_in_operation_mode: {
-            DEBUG_PRINTF("s:%s d:%s ENUM_in_operation_mode %g\n", source.c_str(), dest.c_str(), (double)message.value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setMode(source, operationModeToMode(message.value));
-            break;
-        }
-        case MessageNumber::ENUM_in_fan_mode: {
-            DEBUG_PRINTF("s:%s d:%s ENUM_in_fan_mode %g\n", source.c_str(), dest.c_str(), (double)message.value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            FanMode mode = FanMode::Unknown;
-            if (message.value == 0) mode = FanMode::Auto;
-            else if (message.value == 1) mode = FanMode::Low;
-            else if (message.value == 2) mode = FanMode::Mid;
-            else if (message.value == 3) mode = FanMode::High;
-            else if (message.value == 4) mode = FanMode::Turbo;
-            target->setFanMode(source, mode);
-            break;
-        }
-        case MessageNumber::ENUM_in_louver_hl_swing: {
-            DEBUG_PRINTF("s:%s d:%s ENUM_in_louver_hl_swing %g\n", source.c_str(), dest.c_str(), (double)message.value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setSwingVertical(source, message.value == 1);
-            break;
-        }
-        case MessageNumber::ENUM_in_louver_lr_swing: {
-            DEBUG_PRINTF("s:%s d:%s ENUM_in_louver_lr_swing %g\n", source.c_str(), dest.c_str(), (double)message.value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setSwingHorizontal(source, message.value == 1);
-            break;
-        }
-        case MessageNumber::ENUM_in_alt_mode: {
-            DEBUG_PRINTF("s:%s d:%s ENUM_in_alt_mode %g\n", source.c_str(), dest.c_str(), (double)message.value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            Preset preset = static_cast<Preset>(message.value);
-            target->setPreset(source, preset);
-            break;
-        }
-        case MessageNumber::VAR_out_sensor_airout: {
-            double temp = (double)((int16_t)message.value) / 10.0;
-            DEBUG_PRINTF("s:%s d:%s VAR_out_sensor_airout %g\n", source.c_str(), dest.c_str(), temp);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setOutdoorTemperature(source, temp);
-            break;
-        }
-        case MessageNumber::VAR_in_temp_eva_in_f: {
-            double temp = ((int16_t)message.value) / 10.0;
-            DEBUG_PRINTF("s:%s d:%s VAR_in_temp_eva_in_f %g\n", source.c_str(), dest.c_str(), temp);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setIndoorEvaInTemperature(source, temp);
-            break;
-        }
-        case MessageNumber::VAR_in_temp_eva_out_f: {
-            double temp = ((int16_t)message.value) / 10.0;
-            DEBUG_PRINTF("s:%s d:%s VAR_in_temp_eva_out_f %g\n", source.c_str(), dest.c_str(), temp);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setIndoorEvaOutTemperature(source, temp);
-            break;
-        }
-        case MessageNumber::VAR_out_error_code: {
-            int code = static_cast<int>(message.value);
-            DEBUG_PRINTF("s:%s d:%s VAR_out_error_code %d\n", source.c_str(), dest.c_str(), code);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setErrorCode(source, code);
-            break;
-        }
-        case MessageNumber::LVAR_OUT_CONTROL_WATTMETER_1W_1MIN_SUM: {
-            double value = static_cast<double>(message.value);
-            DEBUG_PRINTF("s:%s d:%s LVAR_OUT_CONTROL_WATTMETER_1W_1MIN_SUM %g\n", source.c_str(), dest.c_str(), value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setOutdoorInstantaneousPower(source, value);
-            break;
-        }
-        case MessageNumber::LVAR_OUT_CONTROL_WATTMETER_ALL_UNIT_ACCUM: {
-            double value = static_cast<double>(message.value);
-            DEBUG_PRINTF("s:%s d:%s LVAR_OUT_CONTROL_WATTMETER_ALL_UNIT_ACCUM %g\n", source.c_str(), dest.c_str(), value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setOutdoorCumulativeEnergy(source, value);
-            break;
-        }
-        case MessageNumber::VAR_OUT_SENSOR_CT1: {
-            double value = static_cast<double>(message.value) / 10.0;
-            DEBUG_PRINTF("s:%s d:%s VAR_OUT_SENSOR_CT1 %g\n", source.c_str(), dest.c_str(), value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setOutdoorCurrent(source, value);
-            break;
-        }
-        case MessageNumber::LVAR_NM_OUT_SENSOR_VOLTAGE: {
-            double value = static_cast<double>(message.value);
-            DEBUG_PRINTF("s:%s d:%s LVAR_NM_OUT_SENSOR_VOLTAGE %g\n", source.c_str(), dest.c_str(), value);
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            target->setOutdoorVoltage(source, value);
-            break;
+    
+    // Notifications are broadcast on the unit's own schedule; Responses answer our Read requests
+    if (packet.command.dataType != DataType::Notification && packet.command.dataType != DataType::Response)
+        return;
+        
+    // Collect the whole packet, then apply it to the device in one pass
+    DeviceDelta delta;
+    for (const auto& message : packet.messages) {
+        if (delta.sensorsFull()) {
+            target->applyDelta(packet.sa, delta);
+            delta.clear();
         }
-        // Known outdoor unit messages - store but don't log details
-        case MessageNumber::ENUM_out_operation_odu_mode:
-        case MessageNumber::ENUM_out_operation_heatcool:
-        case MessageNumber::ENUM_out_load_4way:
-            target->setCustomSensor(source, (uint16_t)message.messageNumber, (float)message.value);
-            break;
-            
-        // All other messages are completely ignored (no logging, no storage)
-        default:
-            // Silently ignore unknown messages to keep logs clean
-            break;
+        processMessageSet(packet.sa, packet.da, message, delta);
+    }
+    if (!delta.empty()) {
+        target->applyDelta(packet.sa, delta);
     }
 }
 
-// NasaProtocol implementation
-void NasaProtocol::publishRequest(MessageTarget* target, const String& address, ProtocolRequest& request, uint8_t sequenceNumber) {
-    Packet packet = Packet::createPartial(Address::parse(address), DataType::Request);
-    
-    // Set sequence number if provided
-    if (sequenceNumber > 0) {
-        packet.command.packetNumber = sequenceNumber;
+void processMessageSet(const Address& source, const Address& dest, const MessageSet& message, DeviceDelta& delta) {
+    // Only process and store messages that are in the catalog
+    const MessageInfo* info = findMessageInfo(message.messageNumber);
+    if (!info || message.type == MessageSetType::Structure) {
+        // Silently ignore unknown messages to keep logs clean
+        return;
     }
     
-    if (request.hasMode) {
-        request.hasPower = true; // ensure system turns on when mode is set
-        
-        MessageSet mode(MessageNumber::ENUM_in_operation_mode);
-        mode.value = (int)request.mode;
-        packet.messages.push_back(mode);
+    float value = info->scale(message.value);
+    if (info->flags & MSG_LOG) {
+        DEBUG_PRINTF("s:%s d:%s %s %g\n", source.toString().c_str(), dest.toString().c_str(), info->name, (double)value);
     }
     
-    if (request.hasPower) {
-        MessageSet power(MessageNumber::ENUM_in_operation_power);
-        power.value = request.power ? 1 : 0;
-        packet.messages.push_back(power);
+    if (!delta.sensorsFull()) {
+        DeviceDelta::Sensor& sensor = delta.sensors[delta.sensorCount++];
+        sensor.messageNumber = (uint16_t)message.messageNumber;
+        sensor.value = (float)message.value;
     }
     
-    if (request.hasTargetTemperature) {
-        MessageSet targettemp(MessageNumber::VAR_in_temp_target_f);
-        targettemp.value = request.targetTemperature * 10.0;
-        packet.messages.push_back(targettemp);
+    switch (info->field) {
+        case DeviceField::Power: delta.power = message.value != 0; break;
+        case DeviceField::Mode: delta.mode = operationModeToMode(message.value); break;
+        case DeviceField::TargetTemperature: delta.targetTemperature = value; break;
+        case DeviceField::RoomTemperature: delta.roomTemperature = value; break;
+        case DeviceField::OutdoorTemperature: delta.outdoorTemperature = value; break;
+        case DeviceField::EvaInTemperature: delta.evaInTemperature = value; break;
+        case DeviceField::EvaOutTemperature: delta.evaOutTemperature = value; break;
+        case DeviceField::FanMode: delta.fanMode = nasaFanModeToFanMode(message.value); break;
+        case DeviceField::SwingVertical: delta.swingVertical = message.value == 1; break;
+        case DeviceField::SwingHorizontal: delta.swingHorizontal = message.value == 1; break;
+        case DeviceField::Preset: delta.preset = static_cast<Preset>(message.value); break;
+        case DeviceField::ErrorCode: delta.errorCode = static_cast<int>(message.value); break;
+        case DeviceField::InstantaneousPower: delta.instantaneousPower = value; break;
+        case DeviceField::CumulativeEnergy: delta.cumulativeEnergy = value; break;
+        case DeviceField::Current: delta.current = value; break;
+        case DeviceField::Voltage: delta.voltage = value; break;
+        case DeviceField::None:
+        default:
+            return;
     }
+    delta.dirty |= fieldBit(info->field);
+}
+
+// NasaProtocol implementation
+
+// Request and Read frames are written straight into the caller's buffer: no
+// Packet, no message vector, nothing allocated per command or poll
+static void beginRequestFrame(ByteWriter& writer, const Address& address, DataType dataType) {
+    Command command;
+    command.packetInformation = true;
+    command.packetType = PacketType::Normal;
+    command.dataType = dataType;
+    command.packetNumber = 0;   // Placeholder, stamped at send time by patchPacketNumber
+    beginFrame(writer, Address::getMyAddress(), address, command, 0);
+}
+
+static void putMessage(ByteWriter& writer, MessageNumber number, int32_t value, uint8_t& count) {
+    MessageSet message(number);
+    message.value = value;
+    message.encode(writer, ByteView());
+    count++;
+}
+
+// Patches the message count; 0 if there were no messages or the frame did not fit
+static size_t finishRequestFrame(ByteWriter& writer, uint8_t count) {
+    if (count == 0 || writer.length <= MESSAGE_COUNT_INDEX)
+        return 0;
+    writer.data[MESSAGE_COUNT_INDEX] = count;
+    return finishFrame(writer);
+}
+
+size_t NasaProtocol::encodeRequest(const Address& address, const QueuedRequest& request, uint8_t* buffer, size_t capacity) {
+    ByteWriter writer(buffer, capacity);
+    beginRequestFrame(writer, address, DataType::Request);
+    uint8_t count = 0;
     
-    if (request.hasFanMode) {
-        MessageSet fanmode(MessageNumber::ENUM_in_fan_mode);
-        fanmode.value = fanModeToNasaFanMode(request.fanMode);
-        packet.messages.push_back(fanmode);
-    }
+    if (request.hasMode)
+        putMessage(writer, MessageNumber::ENUM_in_operation_mode, request.mode, count);
     
-    if (request.hasSwingVertical || request.hasSwingHorizontal) {
-        if (request.hasSwingVertical) {
-            MessageSet hl_swing(MessageNumber::ENUM_in_louver_hl_swing);
-            hl_swing.value = request.swingVertical ? 1 : 0;
-            packet.messages.push_back(hl_swing);
-        }
-        
-        if (request.hasSwingHorizontal) {
-            MessageSet lr_swing(MessageNumber::ENUM_in_louver_lr_swing);
-            lr_swing.value = request.swingHorizontal ? 1 : 0;
-            packet.messages.push_back(lr_swing);
-        }
-    }
+    // Ensure system turns on when mode is set
+    if (request.hasPower || request.hasMode)
+        putMessage(writer, MessageNumber::ENUM_in_operation_power, (request.hasPower ? request.power : true) ? 1 : 0, count);
     
-    if (request.hasPreset) {
-        MessageSet preset(MessageNumber::ENUM_in_alt_mode);
-        preset.value = static_cast<int>(request.preset);
-        packet.messages.push_back(preset);
-    }
+    if (request.hasTargetTemperature)
+        putMessage(writer, MessageNumber::VAR_in_temp_target_f, request.targetTemperatureTenths, count);
     
-    if (packet.messages.size() == 0)
-        return;
-        
-    DEBUG_PRINTF("Sending command to %s (seq: %d) with %d messages\n", 
-                 address.c_str(), sequenceNumber, packet.messages.size());
+    if (request.hasFanMode)
+        putMessage(writer, MessageNumber::ENUM_in_fan_mode, fanModeToNasaFanMode((FanMode)request.fanMode), count);
     
-    auto data = packet.encode();
-    target->publishData(data);
+    if (request.hasSwingVertical)
+        putMessage(writer, MessageNumber::ENUM_in_louver_hl_swing, request.swingVertical ? 1 : 0, count);
+    
+    if (request.hasSwingHorizontal)
+        putMessage(writer, MessageNumber::ENUM_in_louver_lr_swing, request.swingHorizontal ? 1 : 0, count);
+    
+    if (request.hasPreset)
+        putMessage(writer, MessageNumber::ENUM_in_alt_mode, request.preset, count);
+    
+    return finishRequestFrame(writer, count);
 }
 
-void NasaProtocol::protocolUpdate(MessageTarget* target) {
-    // Unused for NASA protocol
+void NasaProtocol::patchPacketNumber(uint8_t* frame, size_t length, uint8_t packetNumber) {
+    // start(1) + size(2) + sa(3) + da(3) + command bytes 0..1
+    const size_t packetNumberIndex = 11;
+    frame[packetNumberIndex] = packetNumber;
+    
+    uint16_t checksum = Crc16::compute(frame + 3, length - 6);
+    frame[length - 3] = (uint8_t)(checksum >> 8);
+    frame[length - 2] = (uint8_t)(checksum & 0xFF);
+}
+
+size_t NasaProtocol::encodeRead(const Address& address, const MessageNumber* messages, size_t count,
+                               uint8_t* buffer, size_t capacity) {
+    if (count > 255)
+        return 0;
+    
+    ByteWriter writer(buffer, capacity);
+    beginRequestFrame(writer, address, DataType::Read);
+    uint8_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        putMessage(writer, messages[i], 0, written);
+    }
+    
+    return finishRequestFrame(writer, written);
 }
\ No newline at end of file
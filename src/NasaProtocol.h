@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include <vector>
+#include "RingBuffer.h"
 
 // Enums from the original ESP Home component
 enum class AddressClass : uint8_t {
@@ -170,6 +171,22 @@ enum class SwingMode : uint8_t {
     All = 3
 };
 
+// Bounded writer over a caller-provided buffer. Encoding never allocates;
+// running past the end sets overflow instead of writing.
+struct ByteWriter {
+    uint8_t* data;
+    size_t capacity;
+    size_t length = 0;
+    bool overflow = false;
+    
+    ByteWriter(uint8_t* buffer, size_t bufferCapacity) : data(buffer), capacity(bufferCapacity) {}
+    
+    void put(uint8_t byte) {
+        if (length < capacity) data[length++] = byte;
+        else overflow = true;
+    }
+};
+
 struct Address {
     AddressClass klass;
     uint8_t channel;
@@ -179,11 +196,25 @@ struct Address {
     static Address parse(const String& str);
     static Address getMyAddress();
     
-    void decode(std::vector<uint8_t>& data, unsigned int index);
-    void encode(std::vector<uint8_t>& data);
-    String toString();
+    // Packed 24-bit form (class << 16 | channel << 8 | address), used as the device key
+    uint32_t pack() const { return ((uint32_t)klass << 16) | ((uint32_t)channel << 8) | address; }
+    static Address unpack(uint32_t packed);
+    bool operator==(const Address& other) const { return pack() == other.pack(); }
+    bool operator!=(const Address& other) const { return pack() != other.pack(); }
+    
+    // Classes 0xB0-0xBF address every unit of a layer; nobody ACKs them
+    bool isBroadcast() const { return ((uint8_t)klass & 0xF0) == 0xB0; }
+    
+    void decode(const ByteView& data, unsigned int index);
+    void encode(ByteWriter& writer) const;
+    String toString() const;
 };
 
+// Group control requests go to the set layer: B2.<channel>.FF reaches the
+// indoor units of one channel, B2.FF.FF every indoor unit on the bus
+static const AddressClass GROUP_CONTROL_CLASS = AddressClass::BroadcastSetLayer;
+static const uint8_t GROUP_ANY = 0xFF;
+
 struct Command {
     bool packetInformation = true;
     uint8_t protocolVersion = 2;
@@ -193,75 +224,99 @@ struct Command {
     uint8_t packetNumber = 0;
     uint8_t size = 3;
     
-    void decode(std::vector<uint8_t>& data, unsigned int index);
-    void encode(std::vector<uint8_t>& data);
-    String toString();
+    void decode(const ByteView& data, unsigned int index);
+    void encode(ByteWriter& writer) const;
+    String toString() const;
 };
 
-struct Buffer {
-    uint8_t size;
-    uint8_t data[255];
+// Structure payloads are not copied out of the frame: they are an offset/length
+// view into Packet::frame, valid for as long as that frame is (until the RX
+// ring releases it after processNasaPacket)
+struct StructureRef {
+    uint16_t offset;    // Frame offset of the first payload byte (after the message number)
+    uint16_t length;
 };
 
+// Compact 8-byte message record
 struct MessageSet {
     MessageNumber messageNumber = MessageNumber::Undefined;
     MessageSetType type = MessageSetType::Enum;
     union {
-        long value;
-        Buffer structure;
+        int32_t value;
+        StructureRef structure;
     };
-    uint16_t size = 2;
     
     MessageSet(MessageNumber messageNumber);
-    static MessageSet decode(std::vector<uint8_t>& data, unsigned int index, int capacity);
-    void encode(std::vector<uint8_t>& data);
-    String toString();
+    static MessageSet decode(const ByteView& data, unsigned int index, int capacity);
+    uint16_t size() const;  // Encoded size including the message number
+    void encode(ByteWriter& writer, const ByteView& frame) const;
+    String toString() const;
 };
 
+static_assert(sizeof(MessageSet) == 8, "MessageSet should stay a compact 8-byte record");
+
 enum class DecodeResult {
     Ok = 0,
     InvalidStartByte = 1,
     InvalidEndByte = 2,
     SizeDidNotMatch = 3,
     UnexpectedSize = 4,
-    CrcError = 5
+    CrcError = 5,
+    Truncated = 6       // Line went idle before the announced length arrived
 };
 
+static const int DECODE_RESULT_COUNT = 7;
+
+// Frame size limits (start byte to end byte inclusive)
+static const size_t NASA_MIN_FRAME_SIZE = 16;
+static const size_t NASA_MAX_FRAME_SIZE = 1500;
+
 struct Packet {
     Address sa;
     Address da;
     Command command;
     std::vector<MessageSet> messages;
+    ByteView frame;     // Frame this packet was decoded from - backs Structure payloads
     
-    static Packet create(Address da, DataType dataType, MessageNumber messageNumber, int value);
-    static Packet createPartial(Address da, DataType dataType);
+    static Packet create(Address da, DataType dataType, MessageNumber messageNumber, int value, uint8_t packetNumber = 0);
+    static Packet createPartial(Address da, DataType dataType, uint8_t packetNumber = 0);
     
-    DecodeResult decode(std::vector<uint8_t>& data);
-    std::vector<uint8_t> encode();
-    String toString();
+    DecodeResult decode(const ByteView& data);
+    DecodeResult decode(const ByteView& data, uint16_t crc);  // CRC of bytes [3, size - 3) already known
+    size_t encode(uint8_t* buffer, size_t capacity) const;  // Returns frame length, 0 if it does not fit
+    std::vector<uint8_t> encode() const;
+    String toString() const;
 };
 
 // Utility functions
-uint16_t crc16(std::vector<uint8_t>& data, int startIndex, int length);
-String bytesToHex(const std::vector<uint8_t>& data);
+uint16_t crc16(const ByteView& data, int startIndex, int length);
+String bytesToHex(const ByteView& data);
+const char* decodeResultToString(DecodeResult result);
 int variableToSigned(int value);
 
 // Conversion functions
 Mode operationModeToMode(int value);
 FanMode fanModeRealToFanMode(int value);
+FanMode nasaFanModeToFanMode(int value);
 int fanModeToNasaFanMode(FanMode mode);
 
 // Protocol processing functions
-DecodeResult tryDecodeNasaPacket(std::vector<uint8_t> data);
-void processNasaPacket(class MessageTarget* target);
-void processMessageSet(String source, String dest, MessageSet& message, class MessageTarget* target);
+void processNasaPacket(const Packet& packet, class MessageTarget* target);
+void processMessageSet(const Address& source, const Address& dest, const MessageSet& message, struct DeviceDelta& delta);
 
 class NasaProtocol {
 public:
     NasaProtocol() = default;
     
-    void publishRequest(class MessageTarget* target, const String& address, struct ProtocolRequest& request, uint8_t sequenceNumber = 0);
-    void protocolUpdate(class MessageTarget* target);
-};
-
-extern Packet globalPacket;
\ No newline at end of file
+    // Encode a request frame once into buffer (packet number 0); returns its length, 0 if empty.
+    // Request and Read frames are written directly, without a Packet: no allocation
+    size_t encodeRequest(const Address& address, const struct QueuedRequest& request, uint8_t* buffer, size_t capacity);
+    
+    // Re-stamp the packet number of an encoded frame and refresh its CRC (for retries)
+    static void patchPacketNumber(uint8_t* frame, size_t length, uint8_t packetNumber);
+    
+    // Encode a Read request for count message numbers (packet number 0); units
+    // answer with a Response carrying the values. Returns its length, 0 if it does not fit
+    size_t encodeRead(const Address& address, const MessageNumber* messages, size_t count,
+                      uint8_t* buffer, size_t capacity);
+};
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "PollScheduler.h"
+#include "config.h"
+#include <string.h>
+
+// What is polled; the rates come from user_config.h (PollScheduler.h has the
+// defaults). Values units broadcast on their own (power, mode, temperatures,
+// energy) are not listed
+static const MessageNumber INDOOR_AIR[] = {
+    MessageNumber::ENUM_in_state_humidity_percent,
+    MessageNumber::VAR_IN_DUST_SENSOR_PM10_0_VALUE,
+    MessageNumber::VAR_IN_DUST_SENSOR_PM2_5_VALUE,
+    MessageNumber::VAR_IN_DUST_SENSOR_PM1_0_VALUE,
+};
+
+static const MessageNumber INDOOR_SETTINGS[] = {
+    MessageNumber::VAR_IN_FSV_3021,
+    MessageNumber::VAR_IN_FSV_3022,
+    MessageNumber::VAR_IN_FSV_3023,
+    MessageNumber::VAR_in_capacity_request,
+};
+
+static const MessageNumber OUTDOOR_OPERATION[] = {
+    MessageNumber::VAR_out_control_order_cfreq_comp2,
+    MessageNumber::VAR_out_control_target_cfreq_comp2,
+    MessageNumber::VAR_out_sensor_top1,
+    MessageNumber::VAR_OUT_PHASE_CURRENT,
+    MessageNumber::ENUM_out_operation_heatcool,
+};
+
+static const MessageNumber OUTDOOR_IDENTITY[] = {
+    MessageNumber::VAR_OUT_PROJECT_CODE,
+    MessageNumber::VAR_OUT_PRODUCT_OPTION_CAPA,
+};
+
+#define POLL_GROUP(klass, intervalMs, messages, name) \
+    { AddressClass::klass, intervalMs, messages, sizeof(messages) / sizeof(messages[0]), name }
+
+static const PollGroup POLL_GROUPS[] = {
+    POLL_GROUP(Indoor,  POLL_INDOOR_AIR_MS,        INDOOR_AIR,        "indoor_air"),
+    POLL_GROUP(Indoor,  POLL_INDOOR_SETTINGS_MS,   INDOOR_SETTINGS,   "indoor_settings"),
+    POLL_GROUP(Outdoor, POLL_OUTDOOR_OPERATION_MS, OUTDOOR_OPERATION, "outdoor_operation"),
+    POLL_GROUP(Outdoor, POLL_OUTDOOR_IDENTITY_MS,  OUTDOOR_IDENTITY,  "outdoor_identity"),
+};
+
+#undef POLL_GROUP
+
+static_assert(sizeof(POLL_GROUPS) / sizeof(POLL_GROUPS[0]) == POLL_GROUP_COUNT,
+              "POLL_GROUP_COUNT must match POLL_GROUPS");
+
+const PollGroup& pollGroup(size_t index) {
+    return POLL_GROUPS[index];
+}
+
+void PollScheduler::begin(unsigned percent) {
+    airtimePercent = percent > 100 ? 100 : percent;
+    creditMicros = 0;
+    lastRefill = millis();
+    lastScan = lastRefill;
+    lastCommandActivity = lastRefill;
+    waitingForBudget = false;
+    cursor = 0;
+    memset(due, 0, sizeof(due));
+    stats = PollStats();
+}
+
+bool PollScheduler::mayPoll(bool commandsPending, unsigned long nowMs) {
+    if (airtimePercent == 0) return false;
+    if (commandsPending) {
+        lastCommandActivity = nowMs;
+        return false;
+    }
+    return nowMs - lastCommandActivity >= COMMAND_HOLDOFF_MS;
+}
+
+bool PollScheduler::next(const DeviceRegistry& devices, unsigned long nowMs, Address& address,
+                         const PollGroup*& group) {
+    if (nowMs - lastScan < SCAN_INTERVAL_MS) return false;
+    lastScan = nowMs;
+    
+    size_t pairs = devices.size() * POLL_GROUP_COUNT;
+    for (size_t i = 0; i < pairs; i++) {
+        size_t pair = (cursor + i) % pairs;
+        const DeviceEntry& device = devices.at(pair / POLL_GROUP_COUNT);
+        const PollGroup& candidate = POLL_GROUPS[pair % POLL_GROUP_COUNT];
+        if (device.address.klass != candidate.klass || candidate.intervalMs == 0) continue;
+        
+        unsigned long& dueAt = due[pair / POLL_GROUP_COUNT][pair % POLL_GROUP_COUNT];
+        if (dueAt != 0 && (long)(nowMs - dueAt) < 0) continue;
+        
+        dueAt = nowMs + candidate.intervalMs;
+        if (dueAt == 0) dueAt = 1;
+        cursor = pair + 1;
+        address = device.address;
+        group = &candidate;
+        return true;
+    }
+    return false;
+}
+
+bool PollScheduler::hasBudget(unsigned long airtimeMicros, unsigned long nowMs) {
+    // Credit in airtime microseconds: percent of elapsed time, saved up for at most BURST_MS
+    unsigned long elapsed = nowMs - lastRefill;
+    lastRefill = nowMs;
+    unsigned long limit = BURST_MS * 10UL * airtimePercent;
+    if (limit < airtimeMicros) limit = airtimeMicros;   // A small share still gets every poll out eventually
+    creditMicros += elapsed > BURST_MS ? limit : elapsed * 10UL * airtimePercent;
+    if (creditMicros > limit) creditMicros = limit;
+    
+    if (creditMicros >= airtimeMicros) return true;
+    if (!waitingForBudget) {
+        waitingForBudget = true;
+        stats.budgetDeferrals++;
+    }
+    return false;
+}
+
+void PollScheduler::onSent(unsigned long airtimeMicros, size_t messages) {
+    creditMicros = creditMicros > airtimeMicros ? creditMicros - airtimeMicros : 0;
+    waitingForBudget = false;
+    stats.requestsSent++;
+    stats.messagesRequested += messages;
+    stats.airtimeMicros += airtimeMicros;
+}
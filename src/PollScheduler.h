@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+#include "NasaProtocol.h"
+#include "DeviceRegistry.h"
+#include "user_config.h"
+
+// Share of bus airtime (request plus expected response) that Read polling may
+// use; 0 disables polling. Override in user_config.h
+#ifndef POLL_AIRTIME_PERCENT
+#define POLL_AIRTIME_PERCENT 5
+#endif
+
+// How often each poll group is read from every device of its class, in
+// milliseconds; 0 leaves the group out. Override in user_config.h
+#ifndef POLL_INDOOR_AIR_MS
+#define POLL_INDOOR_AIR_MS 60000UL
+#endif
+#ifndef POLL_INDOOR_SETTINGS_MS
+#define POLL_INDOOR_SETTINGS_MS 600000UL
+#endif
+#ifndef POLL_OUTDOOR_OPERATION_MS
+#define POLL_OUTDOOR_OPERATION_MS 30000UL
+#endif
+#ifndef POLL_OUTDOOR_IDENTITY_MS
+#define POLL_OUTDOOR_IDENTITY_MS 3600000UL
+#endif
+
+// Messages read together from every device of one address class. The groups
+// live in POLL_GROUPS (PollScheduler.cpp), in flash like the message catalog
+struct PollGroup {
+    AddressClass klass;
+    unsigned long intervalMs;
+    const MessageNumber* messages;
+    uint8_t count;
+    const char* name;
+};
+
+static const size_t POLL_GROUP_COUNT = 4;
+const PollGroup& pollGroup(size_t index);
+
+struct PollStats {
+    unsigned long requestsSent = 0;
+    unsigned long messagesRequested = 0;
+    unsigned long responses = 0;
+    unsigned long budgetDeferrals = 0;      // Due polls that had to wait for airtime credit
+    unsigned long airtimeMicros = 0;        // Charged to the budget so far
+};
+
+// Decides which Read request to send next, if any.
+//
+// Every (device, group) pair has a due time; a round-robin cursor picks the
+// next due pair so no device starves. Sending is limited by a token bucket of
+// airtime: credit accrues at POLL_AIRTIME_PERCENT of real time, up to a few
+// polls' worth, and each poll is charged its frame plus an equally long
+// response. Polls are background traffic: none go out while commands are
+// queued, or shortly after one was sent, when its ACK and confirmation need
+// the bus.
+class PollScheduler {
+public:
+    void begin(unsigned airtimePercent = POLL_AIRTIME_PERCENT);
+    
+    // False while commands own the bus
+    bool mayPoll(bool commandsPending, unsigned long nowMs);
+    
+    // Next due (device, group) pair; marks it polled. False if nothing is due
+    bool next(const DeviceRegistry& devices, unsigned long nowMs, Address& address, const PollGroup*& group);
+    
+    // True if a poll costing airtimeMicros fits the remaining credit
+    bool hasBudget(unsigned long airtimeMicros, unsigned long nowMs);
+    
+    void onSent(unsigned long airtimeMicros, size_t messages);
+    void onResponse() { stats.responses++; }
+    
+    const PollStats& getStats() const { return stats; }
+    unsigned getAirtimePercent() const { return airtimePercent; }
+    
+private:
+    static const unsigned long SCAN_INTERVAL_MS = 100;      // Due times are checked this often
+    static const unsigned long COMMAND_HOLDOFF_MS = 1000;   // Bus left to a command's ACK and notification
+    static const unsigned long BURST_MS = 5000;             // Credit saved up for at most this long
+    
+    unsigned airtimePercent = 0;
+    unsigned long creditMicros = 0;
+    unsigned long lastRefill = 0;
+    unsigned long lastScan = 0;
+    unsigned long lastCommandActivity = 0;
+    bool waitingForBudget = false;
+    size_t cursor = 0;                      // Next device * POLL_GROUP_COUNT + group to look at
+    
+    // Next poll per registry entry and group; 0 = not scheduled yet
+    unsigned long due[DeviceRegistry::MAX_DEVICES][POLL_GROUP_COUNT];
+    
+    PollStats stats;
+};
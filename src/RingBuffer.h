@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Read-only view over up to two contiguous byte segments. A frame sitting in
+// the RX ring buffer may wrap around the end of the storage, so decoding works
+// on this view instead of copying the frame into a linear vector first.
+struct ByteView {
+    const uint8_t* first = nullptr;
+    size_t firstLength = 0;
+    const uint8_t* second = nullptr;
+    size_t secondLength = 0;
+
+    ByteView() = default;
+    ByteView(const uint8_t* data, size_t length) : first(data), firstLength(length) {}
+    ByteView(const std::vector<uint8_t>& data) : first(data.data()), firstLength(data.size()) {}
+    ByteView(const uint8_t* a, size_t aLength, const uint8_t* b, size_t bLength)
+        : first(a), firstLength(aLength), second(b), secondLength(bLength) {}
+
+    size_t size() const { return firstLength + secondLength; }
+    bool empty() const { return size() == 0; }
+
+    uint8_t operator[](size_t index) const {
+        return index < firstLength ? first[index] : second[index - firstLength];
+    }
+
+    // Sub-view of [offset, offset + length), still without copying
+    ByteView slice(size_t offset, size_t length) const {
+        if (offset >= firstLength) {
+            return ByteView(second + (offset - firstLength), length);
+        }
+        size_t head = firstLength - offset;
+        if (length <= head) {
+            return ByteView(first + offset, length);
+        }
+        return ByteView(first + offset, head, second, length - head);
+    }
+
+    // Copy out into a caller buffer (used only where a linear copy is unavoidable)
+    void copyTo(uint8_t* dest, size_t offset, size_t length) const {
+        for (size_t i = 0; i < length; i++) {
+            dest[i] = (*this)[offset + i];
+        }
+    }
+};
+
+// Fixed-capacity single-producer byte ring. Capacity must be a power of two so
+// index wrapping is a mask. No heap allocation after construction.
+template <size_t Capacity>
+class RingBuffer {
+    static_assert((Capacity & (Capacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+private:
+    uint8_t storage[Capacity];
+    size_t head = 0;    // Index of the oldest byte
+    size_t count = 0;   // Number of stored bytes
+
+public:
+    static constexpr size_t capacity() { return Capacity; }
+
+    size_t size() const { return count; }
+    size_t freeSpace() const { return Capacity - count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == Capacity; }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+    uint8_t operator[](size_t index) const {
+        return storage[(head + index) & (Capacity - 1)];
+    }
+
+    bool push(uint8_t byte) {
+        if (full()) return false;
+        storage[(head + count) & (Capacity - 1)] = byte;
+        count++;
+        return true;
+    }
+
+    // Contiguous writable region at the tail, so a UART driver can read
+    // straight into the ring. Call commit() with the number of bytes written.
+    uint8_t* writePointer(size_t& contiguous) {
+        size_t tail = (head + count) & (Capacity - 1);
+        size_t untilEnd = Capacity - tail;
+        size_t available = freeSpace();
+        contiguous = untilEnd < available ? untilEnd : available;
+        return &storage[tail];
+    }
+
+    void commit(size_t length) {
+        count += length;
+    }
+
+    // Drop bytes from the front - O(1), nothing is moved
+    void consume(size_t length) {
+        if (length > count) length = count;
+        head = (head + length) & (Capacity - 1);
+        count -= length;
+    }
+
+    ByteView view(size_t offset, size_t length) const {
+        size_t start = (head + offset) & (Capacity - 1);
+        size_t untilEnd = Capacity - start;
+        if (length <= untilEnd) {
+            return ByteView(&storage[start], length);
+        }
+        return ByteView(&storage[start], untilEnd, storage, length - untilEnd);
+    }
+};
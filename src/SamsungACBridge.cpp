@@ -1,9 +1,13 @@
 #include "SamsungACBridge.h"
 #include "config.h"
 #include <Arduino.h>
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
 
-SamsungACBridge::SamsungACBridge() {
-    serial = &Serial2; // Use Hardware Serial 2 for Samsung communication
+SamsungACBridge::SamsungACBridge() : uart(Serial2, 2), transport(&uart) {
+    decoder.setTap(&capture);
+    commandQueue.setDevices(&devices);
 }
 
 SamsungACBridge::~SamsungACBridge() {
@@ -11,56 +15,122 @@ SamsungACBridge::~SamsungACBridge() {
 }
 
 void SamsungACBridge::begin(int rxPin, int txPin, unsigned long baudRate) {
+    uart.setPins(rxPin, txPin, RS485_DE_PIN);
+    begin(uart, baudRate);
+}
+
+bool SamsungACBridge::begin(ByteTransport& busTransport, unsigned long baudRate) {
     DEBUG_PRINTLN("Samsung AC Bridge initializing...");
     
-    // Initialize UART for Samsung communication - Samsung AC uses Even parity
-    serial->begin(baudRate, SERIAL_8E1, rxPin, txPin);
-    serial->setTimeout(100);
-    
-    DEBUG_PRINTF("UART initialized on pins RX:%d TX:%d at %lu baud\n", rxPin, txPin, baudRate);
+#ifdef ESP32
+    // The task holds the transport pointer; it is chosen once
+    if (busTaskHandle && &busTransport != transport) {
+        DEBUG_PRINTLN("Bus transport cannot change while the RS485 task runs");
+        return false;
+    }
+#endif
+    transport = &busTransport;
+    if (!transport->begin(baudRate)) {
+        DEBUG_PRINTLN("Bus transport failed to open");
+        return false;
+    }
     
-    rxBuffer.clear();
+    decoder.reset();
     devices.clear();
-    discoveredAddresses.clear();
+    txScheduler.begin(baudRate);
+    pollScheduler.begin();
+    pollFrameLength = 0;
+    
+#ifdef ESP32
+    if (!busTaskHandle) {
+        ioStats.task = xTaskCreatePinnedToCore(busTask, "rs485", 4096, this, RS485_TASK_PRIORITY,
+                                               &busTaskHandle, RS485_TASK_CORE) == pdPASS;
+        DEBUG_PRINTF("RS485 task %s on core %d\n", ioStats.task ? "started" : "failed to start", RS485_TASK_CORE);
+    }
+#endif
     
     DEBUG_PRINTLN("Samsung AC Bridge ready");
+    return true;
 }
 
-void SamsungACBridge::loop() {
-    // Check for transmission timeout
-    unsigned long now = millis();
-    if (!rxBuffer.empty() && (now - lastTransmission >= TRANSMISSION_TIMEOUT_MS)) {
-        DEBUG_PRINTLN("Transmission timeout - clearing buffer");
-        rxBuffer.clear();
+#ifdef ESP32
+void SamsungACBridge::busTask(void* arg) {
+    SamsungACBridge* bridge = static_cast<SamsungACBridge*>(arg);
+    for (;;) {
+        bridge->pumpTransport();
+        vTaskDelay(1);  // One tick: about a byte at 9600 baud, well inside the UART FIFO
+    }
+}
+#endif
+
+void SamsungACBridge::pumpTransport() {
+    // One frame on the wire at a time; TX-done goes back to the loop. A full
+    // event ring holds the frame as active until the loop catches up
+    if (txActive && !txDoneRing.full()) {
+        unsigned long checked = micros();
+        if (transport->txDone()) {
+            txCurrent.doneMicros = checked;
+            unsigned long airtime = checked - txCurrent.startMicros;
+            if (airtime > ioStats.txPeakMicros) ioStats.txPeakMicros = airtime;
+            *txDoneRing.claim() = txCurrent;
+            txDoneRing.publish();
+            txActive = false;
+            ioStats.txFrames++;
+        } else {
+            txCurrent.busyMicros = checked;
+        }
     }
     
-    // Process command queue
-    QueuedCommand* cmdToSend = commandQueue.getNextCommandToSend();
-    if (cmdToSend) {
-        // Send the command
-        uint8_t seqNum = currentSequenceNumber++;
-        if (currentSequenceNumber == 0) currentSequenceNumber = 1; // Skip 0
-        
-        // Convert QueuedRequest back to ProtocolRequest
-        ProtocolRequest protocolReq;
-        protocolReq.power = cmdToSend->request.power;
-        protocolReq.hasPower = cmdToSend->request.hasPower;
-        protocolReq.mode = (Mode)cmdToSend->request.mode;
-        protocolReq.hasMode = cmdToSend->request.hasMode;
-        protocolReq.targetTemperature = cmdToSend->request.targetTemperature;
-        protocolReq.hasTargetTemperature = cmdToSend->request.hasTargetTemperature;
-        protocolReq.fanMode = (FanMode)cmdToSend->request.fanMode;
-        protocolReq.hasFanMode = cmdToSend->request.hasFanMode;
-        protocolReq.swingVertical = cmdToSend->request.swingVertical;
-        protocolReq.hasSwingVertical = cmdToSend->request.hasSwingVertical;
-        protocolReq.swingHorizontal = cmdToSend->request.swingHorizontal;
-        protocolReq.hasSwingHorizontal = cmdToSend->request.hasSwingHorizontal;
-        protocolReq.preset = (Preset)cmdToSend->request.preset;
-        protocolReq.hasPreset = cmdToSend->request.hasPreset;
+    // Read before writing, so the idle check below sees the latest bytes. A full
+    // ring leaves the bytes in the transport, where the driver keeps buffering them
+    while (transport->available() > 0) {
+        RxChunk* chunk = rxRing.claim();
+        if (!chunk) {
+            ioStats.rxRingFull++;
+            break;
+        }
+        size_t bytesRead = transport->read(chunk->data, sizeof(chunk->data));
+        if (bytesRead == 0) break;
+        chunk->length = (uint8_t)bytesRead;
+        chunk->micros = micros();
+        rxLastMicros = chunk->micros;
+        rxHeard = true;
+        rxRing.publish();
+        ioStats.rxChunks++;
+    }
+    
+    TxFrame* frame = txActive ? nullptr : txRing.peek();
+    if (frame && txWritten == 0) {
+        // The loop queued the frame after the holdoff had passed since the
+        // chunks it had seen; anything read since (including chunks it had
+        // not picked up yet) means someone is talking, so wait for quiet again
+        bool busy = transport->available() > 0 ||
+                    (rxHeard && micros() - rxLastMicros < frame->holdoffMicros);
+        if (busy && !txHolding) ioStats.txHeld++;
+        txHolding = busy;
+        if (busy) frame = nullptr;
+    }
+    if (frame) {
+        if (txWritten == 0) {
+            txCurrent.commandId = frame->commandId;
+            txCurrent.length = frame->length;
+            memcpy(txCurrent.data, frame->data, frame->length);
+            txCurrent.startMicros = micros();
+        }
         
-        protocol.publishRequest(this, cmdToSend->targetAddress, protocolReq, seqNum);
-        commandQueue.markCommandSent(cmdToSend, seqNum);
+        // The transport takes what fits; the rest goes on the next pass
+        txWritten += transport->write(frame->data + txWritten, frame->length - txWritten);
+        txCurrent.busyMicros = micros();
+        if (txWritten >= frame->length) {
+            txRing.release();
+            txWritten = 0;
+            txActive = true;
+        }
     }
+}
+
+void SamsungACBridge::loop() {
+    unsigned long now = millis();
     
     // Cleanup old commands
     static unsigned long lastCleanup = 0;
@@ -69,111 +139,211 @@ void SamsungACBridge::loop() {
         lastCleanup = now;
     }
     
+    if (!ioStats.task) pumpTransport();
+    handleTxDone();
+    
     // Read incoming data
     static unsigned long lastDebug = 0;
-    if (serial->available() > 0 && (now - lastDebug > 5000)) {
-        DEBUG_PRINTF("RS485 bytes available: %d\n", serial->available());
+    if (!rxRing.empty() && (now - lastDebug > 5000)) {
+        DEBUG_PRINTF("RS485 chunks waiting: %d\n", (int)rxRing.size());
         lastDebug = now;
     }
     
-    // Process max 64 bytes per iteration to avoid blocking
-    int bytesToProcess = serial->available();
-    if (bytesToProcess > 64) bytesToProcess = 64;
+    readBus(now);
     
-    while (bytesToProcess-- > 0 && serial->available()) {
-        lastTransmission = now;
-        uint8_t byte = serial->read();
-        // Don't log individual bytes - too noisy
-        // DEBUG_PRINTF("RX: 0x%02X\n", byte);
-        
-        // Skip until start byte found
-        if (rxBuffer.empty() && byte != 0x32) {
-            continue;
-        }
-        
-        rxBuffer.push_back(byte);
-    }
+    // Decode complete packets; they come back through onPacket()
+    decoder.process(now, *this);
     
-    // Try to process complete packet after reading
-    if (!rxBuffer.empty()) {
-        processData(rxBuffer);
-    }
+    retryUnconfirmedMembers();
+    sendNextCommand();
+    sendNextPoll(now);
+    
+    if (!ioStats.task) pumpTransport();
 }
 
-void SamsungACBridge::processData(std::vector<uint8_t>& data) {
-    if (data.size() < 3) return; // Need at least start byte + 2 size bytes
+void SamsungACBridge::sendNextCommand() {
+    // Undecoded bytes mean someone is talking right now, and may hold the ACK
+    // a timeout below would otherwise give up on
+    if (!rxRing.empty() || !decoder.empty()) return;
     
-    // Get expected packet size
-    int expectedSize = ((int)data[1] << 8) | (int)data[2];
-    expectedSize += 2; // Add size bytes themselves
+    QueuedCommand* cmdToSend = commandQueue.getNextCommandToSend();
+    if (!cmdToSend) return;
+    
+    // Wait for a gap in the bus traffic long enough for the whole frame
+    unsigned long nowMicros = micros();
+    if (txRing.full() || !txScheduler.canSend(cmdToSend->frameLength, nowMicros, cmdToSend->deferral)) return;
     
-    if ((int)data.size() < expectedSize) {
-        return; // Wait for more data
+    // The queue owns the packet number space and never reuses an outstanding number
+    uint8_t seqNum = commandQueue.markCommandSent(cmdToSend);
+    if (seqNum == 0) return;
+    
+    // Frame was encoded at queue time - only the packet number and CRC change
+    NasaProtocol::patchPacketNumber(cmdToSend->frame, cmdToSend->frameLength, seqNum);
+    DEBUG_PRINTF("Sending command to %s (seq: %d)\n", cmdToSend->targetAddress.toString().c_str(), seqNum);
+    txScheduler.onSend(cmdToSend->frameLength, nowMicros, cmdToSend->deferral);
+    queueFrame(cmdToSend->frame, cmdToSend->frameLength, cmdToSend->id);
+}
+
+void SamsungACBridge::sendNextPoll(unsigned long now) {
+    // Background traffic: commands, their ACKs and confirmations go first
+    if (!pollScheduler.mayPoll(commandQueue.getPendingCount() > 0, now)) return;
+    
+    if (pollFrameLength == 0) {
+        Address address;
+        const PollGroup* group;
+        if (!pollScheduler.next(devices, now, address, group)) return;
+        pollFrameLength = protocol.encodeRead(address, group->messages, group->count, pollFrame, sizeof(pollFrame));
+        pollMessages = group->count;
+        if (pollFrameLength == 0) return;
     }
     
-    // We have enough data, try to decode
-    std::vector<uint8_t> packetData(data.begin(), data.begin() + expectedSize);
+    // The unit's Response takes about as long as the request
+    unsigned long airtime = 2 * txScheduler.frameMicros(pollFrameLength);
+    if (!pollScheduler.hasBudget(airtime, now)) return;
     
-    DecodeResult result = tryDecodeNasaPacket(packetData);
+    unsigned long nowMicros = micros();
+    if (!rxRing.empty() || txRing.full() || !txScheduler.canSend(pollFrameLength, nowMicros, pollDeferral)) return;
     
-    if (result == DecodeResult::Ok) {
-        // DEBUG_PRINTLN("Valid NASA packet received");  // Too noisy, removed
-        processNasaPacket(this);
+    uint8_t seqNum = commandQueue.takeSequence();
+    if (seqNum == 0) return;
+    
+    NasaProtocol::patchPacketNumber(pollFrame, pollFrameLength, seqNum);
+    txScheduler.onSend(pollFrameLength, nowMicros, pollDeferral);
+    pollScheduler.onSent(airtime, pollMessages);
+    publishData(pollFrame, pollFrameLength);
+    pollFrameLength = 0;
+}
+
+void SamsungACBridge::handleTxDone() {
+    while (TxDone* done = txDoneRing.peek()) {
+        // No earlier than the frame's airtime after the write, no later than
+        // the check that saw it done
+        unsigned long end = done->startMicros + txScheduler.frameMicros(done->length);
+        if ((long)(done->busyMicros - end) > 0) end = done->busyMicros;
+        if ((long)(end - done->doneMicros) > 0) end = done->doneMicros;
         
-        // Remove processed packet from buffer
-        data.erase(data.begin(), data.begin() + expectedSize);
-    } else {
-        DEBUG_PRINTF("Packet decode failed: %d\n", (int)result);
+        txScheduler.onTxDone(done->startMicros, end);
+        capture.record(ByteView(done->data, done->length), DecodeResult::Ok, CAPTURE_FLAG_TX, end);
+        if (done->commandId) {
+            unsigned long doneTime = millis() - (micros() - end) / 1000;
+            commandQueue.markTransmitted(done->commandId, doneTime);
+        }
+        txDoneRing.release();
+    }
+}
+
+void SamsungACBridge::readBus(unsigned long now) {
+    size_t waiting = rxRing.size();
+    if (waiting > ioStats.rxPeakChunks) ioStats.rxPeakChunks = waiting;
+    
+    // Everything the task has read, copied straight into the decoder ring until it is full
+    while (RxChunk* chunk = rxRing.peek()) {
+        if (decoder.full()) break;
+        
+        // Line activity is timed by when the task read the bytes, not by when we got here
+        if (rxChunkOffset == 0) txScheduler.onRxBytes(chunk->length, chunk->micros);
         
-        // Remove first byte and try again
-        data.erase(data.begin());
+        while (rxChunkOffset < chunk->length && !decoder.full()) {
+            size_t contiguous = 0;
+            uint8_t* dest = decoder.writePointer(contiguous);
+            size_t count = std::min(contiguous, (size_t)(chunk->length - rxChunkOffset));
+            memcpy(dest, chunk->data + rxChunkOffset, count);
+            decoder.commit(count, now, chunk->micros);
+            rxChunkOffset += count;
+        }
+        if (rxChunkOffset < chunk->length) break;
+        
+        rxRing.release();
+        rxChunkOffset = 0;
     }
 }
 
 std::vector<String> SamsungACBridge::getDiscoveredDevices() {
+    // Same ordering the old std::set<String> gave: ascending address
+    std::vector<uint32_t> keys;
+    keys.reserve(devices.size());
+    for (size_t i = 0; i < devices.size(); i++) {
+        keys.push_back(devices.at(i).address.pack());
+    }
+    std::sort(keys.begin(), keys.end());
+    
     std::vector<String> result;
-    for (const auto& address : discoveredAddresses) {
-        result.push_back(address);
+    result.reserve(keys.size());
+    for (uint32_t key : keys) {
+        result.push_back(Address::unpack(key).toString());
     }
     return result;
 }
 
 bool SamsungACBridge::isDeviceKnown(const String& address) {
-    return discoveredAddresses.find(address) != discoveredAddresses.end();
+    return devices.find(Address::parse(address)) != nullptr;
 }
 
 bool SamsungACBridge::isDeviceOnline(const String& address) {
-    auto it = devices.find(address);
-    if (it == devices.end()) return false;
+    const DeviceEntry* device = devices.find(Address::parse(address));
+    if (!device) return false;
     
     unsigned long now = millis();
-    return (now - it->second.lastUpdate) < DEVICE_TIMEOUT_MS_VALUE;
+    return (now - device->state.lastUpdate) < DEVICE_TIMEOUT_MS_VALUE;
 }
 
 String SamsungACBridge::getDeviceType(const String& address) {
-    // Parse address to determine type
-    int dotIndex = address.indexOf('.');
-    if (dotIndex == -1) return "Unknown";
-    
-    String klassStr = address.substring(0, dotIndex);
-    uint8_t klass = strtol(klassStr.c_str(), nullptr, 16);
-    
-    if (klass == 0x10) return "Outdoor";
-    else if (klass == 0x20) return "Indoor";
-    else if (klass == 0x50) return "WiredRemote";
-    else if (klass == 0x62) return "WiFiKit";
-    else return "Other";
+    const DeviceEntry* device = devices.find(Address::parse(address));
+    return device ? device->typeName : "Unknown";
 }
 
 DeviceState SamsungACBridge::getDeviceState(const String& address) {
-    auto it = devices.find(address);
-    return (it != devices.end()) ? it->second : DeviceState();
+    const DeviceEntry* device = devices.find(Address::parse(address));
+    return device ? device->state : DeviceState();
 }
 
-bool SamsungACBridge::controlDevice(const String& address, const ControlRequest& request) {
-    if (!isDeviceKnown(address)) {
-        DEBUG_PRINTF("Device %s not known\n", address.c_str());
-        return false;
+LinkTiming SamsungACBridge::getLinkTiming(const String& address) {
+    const DeviceEntry* device = devices.find(Address::parse(address));
+    return device ? device->link : LinkTiming();
+}
+
+bool SamsungACBridge::parseGroupTarget(const String& target, Address& group) {
+    group.klass = GROUP_CONTROL_CLASS;
+    group.address = GROUP_ANY;
+    
+    if (target == "all") {
+        group.channel = GROUP_ANY;
+        return true;
+    }
+    
+    // "20.<channel>.*": indoor units of one channel, two hex digits. strtol
+    // alone would take a sign or whitespace and turn garbage into channel 0
+    const char* text = target.c_str();
+    if (target.length() != 7 || strncmp(text, "20.", 3) != 0 || strcmp(text + 5, ".*") != 0) return false;
+    if (!isxdigit((unsigned char)text[3]) || !isxdigit((unsigned char)text[4])) return false;
+    
+    char* end;
+    group.channel = strtol(text + 3, &end, 16);
+    return end == text + 5;
+}
+
+size_t SamsungACBridge::collectGroupMembers(const Address& group, uint32_t* members) const {
+    size_t count = 0;
+    for (size_t i = 0; i < devices.size(); i++) {
+        const Address& address = devices.at(i).address;
+        if (address.klass != AddressClass::Indoor) continue;
+        if (group.channel != GROUP_ANY && address.channel != group.channel) continue;
+        members[count++] = address.pack();
+    }
+    return count;
+}
+
+bool SamsungACBridge::controlDevice(const String& addressString, const ControlRequest& request, ControlResult* result) {
+    if (result) *result = ControlResult();
+    
+    Address address;
+    if (!parseGroupTarget(addressString, address)) {
+        // A malformed group target must not fall through to a device address
+        address = Address::parse(addressString);
+        if (addressString.endsWith(".*") || !devices.find(address)) {
+            DEBUG_PRINTF("Device %s not known\n", addressString.c_str());
+            return false;
+        }
     }
     
     // Convert ControlRequest to QueuedRequest
@@ -190,7 +360,7 @@ bool SamsungACBridge::controlDevice(const String& address, const ControlRequest&
     }
     
     if (request.hasTargetTemperature) {
-        queuedRequest.targetTemperature = request.targetTemperature;
+        queuedRequest.setTargetTemperature(request.targetTemperature);
         queuedRequest.hasTargetTemperature = true;
     }
     
@@ -214,146 +384,161 @@ bool SamsungACBridge::controlDevice(const String& address, const ControlRequest&
         queuedRequest.hasPreset = true;
     }
     
-    // Add command to queue instead of sending directly
-    QueuedCommand* cmd = commandQueue.addCommand(address, queuedRequest);
-    
-    return cmd != nullptr;
-}
-
-// MessageTarget interface implementation
-void SamsungACBridge::publishData(std::vector<uint8_t>& data) {
-    DEBUG_PRINTF("TX: %d bytes to RS485\n", data.size());
-    // Full hex dump is too noisy
-    // DEBUG_PRINTF("Sending data: %s\n", bytesToHex(data).c_str());
-    serial->write(data.data(), data.size());
-    serial->flush();
+    return queueRequest(address, queuedRequest, request.priority, request.deadlineMs, result);
 }
 
-void SamsungACBridge::registerAddress(const String& address) {
-    if (discoveredAddresses.find(address) == discoveredAddresses.end()) {
-        DEBUG_PRINTF("Discovered new device: %s (%s)\n", address.c_str(), getDeviceType(address).c_str());
-        discoveredAddresses.insert(address);
+bool SamsungACBridge::queueRequest(const Address& address, const QueuedRequest& request, CommandPriority priority,
+                                   unsigned long deadlineMs, ControlResult* result) {
+    uint32_t members[DeviceRegistry::MAX_DEVICES];
+    size_t memberCount = 0;
+    if (address.isBroadcast()) {
+        memberCount = collectGroupMembers(address, members);
+        if (memberCount == 0) {
+            DEBUG_PRINTF("No devices in group %s\n", address.toString().c_str());
+            return false;
+        }
+        if (result) result->members = memberCount;
     }
-    updateDeviceState(address);
-}
-
-void SamsungACBridge::updateDeviceState(const String& address) {
-    devices[address].lastUpdate = millis();
+    const uint32_t* memberList = address.isBroadcast() ? members : nullptr;
     
-    // Check if any queued command is now confirmed
-    DeviceState& state = devices[address];
-    commandQueue.checkStateConfirmation(address, state.power, (int)state.mode, 
-                                      state.targetTemperature, (int)state.fanMode, (int)state.preset);
-}
-
-void SamsungACBridge::setPower(const String& address, bool value) {
-    // Only log if state actually changed
-    if (devices[address].power != value) {
-        DEBUG_PRINTF("Device %s power: %s\n", address.c_str(), value ? "ON" : "OFF");
+    QueuedRequest queuedRequest = request;
+    
+    // A command for this device that is still waiting to go out absorbs the new
+    // fields, so a burst of requests becomes one frame with one ACK cycle
+    QueuedCommand* unsent = commandQueue.findUnsent(address);
+    if (unsent) {
+        QueuedRequest combined = unsent->request;
+        combined.merge(queuedRequest);
+        queuedRequest = combined;
     }
-    devices[address].power = value;
-    updateDeviceState(address);
-}
-
-void SamsungACBridge::setRoomTemperature(const String& address, float value) {
-    // Room temp changes frequently, only log significant changes
-    float oldValue = devices[address].roomTemperature;
-    if (abs(oldValue - value) > 0.5) {
-        DEBUG_PRINTF("Device %s room temperature: %.1f°C\n", address.c_str(), value);
-    }
-    devices[address].roomTemperature = value;
-    updateDeviceState(address);
-}
-
-void SamsungACBridge::setTargetTemperature(const String& address, float value) {
-    if (devices[address].targetTemperature != value) {
-        DEBUG_PRINTF("Device %s target temperature: %.1f°C\n", address.c_str(), value);
+    
+    // Encode the frame once; retries only re-stamp packet number and CRC
+    uint8_t frame[MAX_COMMAND_FRAME_SIZE];
+    size_t frameLength = protocol.encodeRequest(address, queuedRequest, frame, sizeof(frame));
+    if (frameLength == 0) {
+        DEBUG_PRINTF("Nothing to send to %s\n", address.toString().c_str());
+        return false;
     }
-    devices[address].targetTemperature = value;
-    updateDeviceState(address);
-}
-
-void SamsungACBridge::setOutdoorTemperature(const String& address, float value) {
-    devices[address].outdoorTemperature = value;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s outdoor temperature: %.1f°C\n", address.c_str(), value);
-}
-
-void SamsungACBridge::setIndoorEvaInTemperature(const String& address, float value) {
-    devices[address].evaInTemperature = value;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s eva in temperature: %.1f°C\n", address.c_str(), value);
-}
-
-void SamsungACBridge::setIndoorEvaOutTemperature(const String& address, float value) {
-    devices[address].evaOutTemperature = value;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s eva out temperature: %.1f°C\n", address.c_str(), value);
-}
-
-void SamsungACBridge::setMode(const String& address, Mode mode) {
-    devices[address].mode = mode;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s mode: %d\n", address.c_str(), (int)mode);
-}
-
-void SamsungACBridge::setFanMode(const String& address, FanMode fanmode) {
-    devices[address].fanMode = fanmode;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s fan mode: %d\n", address.c_str(), (int)fanmode);
-}
-
-void SamsungACBridge::setSwingVertical(const String& address, bool vertical) {
-    devices[address].swingVertical = vertical;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s swing vertical: %s\n", address.c_str(), vertical ? "ON" : "OFF");
-}
-
-void SamsungACBridge::setSwingHorizontal(const String& address, bool horizontal) {
-    devices[address].swingHorizontal = horizontal;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s swing horizontal: %s\n", address.c_str(), horizontal ? "ON" : "OFF");
+    
+    if (unsent) {
+        commandQueue.mergeCommand(unsent, queuedRequest, frame, frameLength, priority, deadlineMs,
+                                  memberList, memberCount);
+        if (result) {
+            result->merged = true;
+            result->commandId = unsent->id;
+        }
+        return true;
+    }
+    
+    // Add command to queue instead of sending directly
+    QueuedCommand* cmd = commandQueue.addCommand(address, queuedRequest, frame, frameLength, priority, deadlineMs,
+                                                 memberList, memberCount);
+    if (result) {
+        result->queueFull = !cmd;
+        result->commandId = cmd ? cmd->id : 0;
+    }
+    return cmd != nullptr;
 }
 
-void SamsungACBridge::setPreset(const String& address, Preset preset) {
-    devices[address].preset = preset;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s preset: %d\n", address.c_str(), (int)preset);
+void SamsungACBridge::retryUnconfirmedMembers() {
+    Address member;
+    QueuedRequest request;
+    CommandPriority priority;
+    // Members stay in their group's list until there is room to queue them
+    while (commandQueue.hasFreeSlot() && commandQueue.takeUnconfirmedMember(member, request, priority)) {
+        queueRequest(member, request, priority, 0, nullptr);
+    }
 }
 
-void SamsungACBridge::setCustomSensor(const String& address, uint16_t message_number, float value) {
-    devices[address].customSensors[message_number] = value;
-    updateDeviceState(address);
-    // Note: Custom sensors are now only stored for messages we explicitly process
-    // No logging here since all stored sensors are known and already logged in processMessageSet
+// MessageTarget interface implementation
+void SamsungACBridge::publishData(const uint8_t* data, size_t length) {
+    queueFrame(data, length, 0);
 }
 
-void SamsungACBridge::setErrorCode(const String& address, int error_code) {
-    devices[address].errorCode = error_code;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s error code: %d\n", address.c_str(), error_code);
+void SamsungACBridge::queueFrame(const uint8_t* data, size_t length, uint32_t commandId) {
+    DEBUG_PRINTF("TX: %d bytes to RS485\n", length);
+    // Full hex dump is too noisy
+    // DEBUG_PRINTF("Sending data: %s\n", bytesToHex(ByteView(data, length)).c_str());
+    // Written by the transport pump; callers check txRing.full() before sending
+    TxFrame* frame = txRing.claim();
+    if (!frame || length > sizeof(frame->data)) {
+        ioStats.txRingFull++;
+        return;
+    }
+    memcpy(frame->data, data, length);
+    frame->length = (uint8_t)length;
+    frame->commandId = commandId;
+    frame->holdoffMicros = txScheduler.getStats().holdoffMicros;
+    txRing.publish();
 }
 
-void SamsungACBridge::setOutdoorInstantaneousPower(const String& address, float value) {
-    devices[address].instantaneousPower = value;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s instantaneous power: %.1fW\n", address.c_str(), value);
+void SamsungACBridge::registerAddress(const Address& address) {
+    bool inserted = false;
+    DeviceEntry* device = devices.findOrInsert(address, inserted);
+    if (!device) {
+        DEBUG_PRINTF("Device table full, ignoring %s\n", address.toString().c_str());
+        return;
+    }
+    if (inserted) {
+        DEBUG_PRINTF("Discovered new device: %s (%s)\n", address.toString().c_str(), device->typeName);
+    }
+    device->state.lastUpdate = millis();
 }
 
-void SamsungACBridge::setOutdoorCumulativeEnergy(const String& address, float value) {
-    devices[address].cumulativeEnergy = value;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s cumulative energy: %.1fWh\n", address.c_str(), value);
+void SamsungACBridge::applyDelta(const Address& address, const DeviceDelta& delta) {
+    DeviceEntry* device = devices.find(address);
+    if (!device) return;
+    
+    DeviceState& state = device->state;
+    uint32_t changed = state.apply(delta);
+    state.lastUpdate = millis();
+    logChanges(*device, changed);
+    
+    // One confirmation pass per packet; a no-op unless a command waits on a reported field
+    commandQueue.checkStateConfirmation(device->address, state, delta.dirty);
 }
 
-void SamsungACBridge::setOutdoorCurrent(const String& address, float value) {
-    devices[address].current = value;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s current: %.1fA\n", address.c_str(), value);
+void SamsungACBridge::logChanges(const DeviceEntry& device, uint32_t changed) {
+#if DEBUG_ENABLED
+    if (!changed) return;
+    const DeviceState& state = device.state;
+    String address = device.address.toString();
+    const char* name = address.c_str();
+    
+    if (changed & fieldBit(DeviceField::Power))
+        DEBUG_PRINTF("Device %s power: %s\n", name, state.power ? "ON" : "OFF");
+    if (changed & fieldBit(DeviceField::Mode))
+        DEBUG_PRINTF("Device %s mode: %d\n", name, (int)state.mode);
+    if (changed & fieldBit(DeviceField::TargetTemperature))
+        DEBUG_PRINTF("Device %s target temperature: %.1f°C\n", name, state.targetTemperature);
+    if (changed & fieldBit(DeviceField::RoomTemperature))
+        DEBUG_PRINTF("Device %s room temperature: %.1f°C\n", name, state.roomTemperature);
+    if (changed & fieldBit(DeviceField::OutdoorTemperature))
+        DEBUG_PRINTF("Device %s outdoor temperature: %.1f°C\n", name, state.outdoorTemperature);
+    if (changed & fieldBit(DeviceField::EvaInTemperature))
+        DEBUG_PRINTF("Device %s eva in temperature: %.1f°C\n", name, state.evaInTemperature);
+    if (changed & fieldBit(DeviceField::EvaOutTemperature))
+        DEBUG_PRINTF("Device %s eva out temperature: %.1f°C\n", name, state.evaOutTemperature);
+    if (changed & fieldBit(DeviceField::FanMode))
+        DEBUG_PRINTF("Device %s fan mode: %d\n", name, (int)state.fanMode);
+    if (changed & fieldBit(DeviceField::SwingVertical))
+        DEBUG_PRINTF("Device %s swing vertical: %s\n", name, state.swingVertical ? "ON" : "OFF");
+    if (changed & fieldBit(DeviceField::SwingHorizontal))
+        DEBUG_PRINTF("Device %s swing horizontal: %s\n", name, state.swingHorizontal ? "ON" : "OFF");
+    if (changed & fieldBit(DeviceField::Preset))
+        DEBUG_PRINTF("Device %s preset: %d\n", name, (int)state.preset);
+    if (changed & fieldBit(DeviceField::ErrorCode))
+        DEBUG_PRINTF("Device %s error code: %d\n", name, state.errorCode);
+    if (changed & fieldBit(DeviceField::InstantaneousPower))
+        DEBUG_PRINTF("Device %s instantaneous power: %.1fW\n", name, state.instantaneousPower);
+    if (changed & fieldBit(DeviceField::CumulativeEnergy))
+        DEBUG_PRINTF("Device %s cumulative energy: %.1fWh\n", name, state.cumulativeEnergy);
+    if (changed & fieldBit(DeviceField::Current))
+        DEBUG_PRINTF("Device %s current: %.1fA\n", name, state.current);
+    if (changed & fieldBit(DeviceField::Voltage))
+        DEBUG_PRINTF("Device %s voltage: %.1fV\n", name, state.voltage);
+#else
+    (void)device;
+    (void)changed;
+#endif
 }
-
-void SamsungACBridge::setOutdoorVoltage(const String& address, float value) {
-    devices[address].voltage = value;
-    updateDeviceState(address);
-    DEBUG_PRINTF("Device %s voltage: %.1fV\n", address.c_str(), value);
-}
\ No newline at end of file
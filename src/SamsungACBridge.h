@@ -1,79 +1,40 @@
 #pragma once
 
 #include <Arduino.h>
-#include <HardwareSerial.h>
 #include <vector>
-#include <map>
-#include <set>
 #include "NasaProtocol.h"
+#include "NasaDecoder.h"
+#include "DeviceRegistry.h"
+#include "BusCapture.h"
 #include "user_config.h"
 #include "CommandQueue.h"
+#include "TxScheduler.h"
+#include "PollScheduler.h"
+#include "SpscRing.h"
+#include "ByteTransport.h"
+#include "UartTransport.h"
 
-struct DeviceState {
-    bool power = false;
-    Mode mode = Mode::Unknown;
-    float targetTemperature = 0.0;
-    float roomTemperature = 0.0;
-    float outdoorTemperature = 0.0;
-    float evaInTemperature = 0.0;
-    float evaOutTemperature = 0.0;
-    FanMode fanMode = FanMode::Unknown;
-    bool swingVertical = false;
-    bool swingHorizontal = false;
-    Preset preset = Preset::None;
-    int errorCode = 0;
-    float instantaneousPower = 0.0;
-    float cumulativeEnergy = 0.0;
-    float current = 0.0;
-    float voltage = 0.0;
-    unsigned long lastUpdate = 0;
-    std::map<uint16_t, float> customSensors;
-};
-
-struct ProtocolRequest {
-    bool power = false;
-    bool hasPower = false;
-    
-    Mode mode = Mode::Unknown;
-    bool hasMode = false;
-    
-    float targetTemperature = 0.0;
-    bool hasTargetTemperature = false;
-    
-    FanMode fanMode = FanMode::Unknown;
-    bool hasFanMode = false;
-    
-    bool swingVertical = false;
-    bool hasSwingVertical = false;
-    
-    bool swingHorizontal = false;
-    bool hasSwingHorizontal = false;
-    
-    Preset preset = Preset::None;
-    bool hasPreset = false;
-};
+// On the ESP32 the transport is serviced by its own task, pinned to the core the
+// Arduino loop does not use (WiFi shares it, but mostly sleeps), so HTTP and
+// OTA work can never stall RX draining. The task only moves bytes; decoding,
+// the registry and the command queue stay on the loop side
+#ifndef RS485_TASK_CORE
+#define RS485_TASK_CORE 0
+#endif
+#ifndef RS485_TASK_PRIORITY
+#define RS485_TASK_PRIORITY 10
+#endif
+#ifndef RS485_DE_PIN
+#define RS485_DE_PIN -1
+#endif
 
 class MessageTarget {
 public:
-    virtual void publishData(std::vector<uint8_t>& data) = 0;
-    virtual void registerAddress(const String& address) = 0;
-    virtual void setPower(const String& address, bool value) = 0;
-    virtual void setRoomTemperature(const String& address, float value) = 0;
-    virtual void setTargetTemperature(const String& address, float value) = 0;
-    virtual void setOutdoorTemperature(const String& address, float value) = 0;
-    virtual void setIndoorEvaInTemperature(const String& address, float value) = 0;
-    virtual void setIndoorEvaOutTemperature(const String& address, float value) = 0;
-    virtual void setMode(const String& address, Mode mode) = 0;
-    virtual void setFanMode(const String& address, FanMode fanmode) = 0;
-    virtual void setSwingVertical(const String& address, bool vertical) = 0;
-    virtual void setSwingHorizontal(const String& address, bool horizontal) = 0;
-    virtual void setPreset(const String& address, Preset preset) = 0;
-    virtual void setCustomSensor(const String& address, uint16_t message_number, float value) = 0;
-    virtual void setErrorCode(const String& address, int error_code) = 0;
-    virtual void setOutdoorInstantaneousPower(const String& address, float value) = 0;
-    virtual void setOutdoorCumulativeEnergy(const String& address, float value) = 0;
-    virtual void setOutdoorCurrent(const String& address, float value) = 0;
-    virtual void setOutdoorVoltage(const String& address, float value) = 0;
+    virtual void publishData(const uint8_t* data, size_t length) = 0;
+    virtual void registerAddress(const Address& address) = 0;
+    virtual void handleAck(uint8_t packetNumber) = 0;
+    virtual void handleNack(uint8_t packetNumber) = 0;
+    virtual void applyDelta(const Address& address, const DeviceDelta& delta) = 0;
 };
 
 struct ControlRequest {
@@ -97,31 +58,111 @@ struct ControlRequest {
     
     Preset preset = Preset::None;
     bool hasPreset = false;
+    
+    // Scheduling: class, and how long the request is worth sending (0 = no deadline)
+    CommandPriority priority = CommandPriority::Interactive;
+    unsigned long deadlineMs = 0;
+};
+
+// What controlDevice did with a request
+struct ControlResult {
+    bool merged = false;        // Folded into a command that had not been sent yet
+    size_t members = 1;         // Devices the command addresses (group targets: discovered members)
+    bool queueFull = false;     // Refused: no free command slot
+    uint32_t commandId = 0;     // Queued (or merged into) command, for getCommand()
+};
+
+// Bytes the RS485 task read from the transport in one go, stamped when read
+struct RxChunk {
+    unsigned long micros;
+    uint8_t length;
+    uint8_t data[32];
+};
+
+// Encoded frame waiting for the RS485 task to write it
+struct TxFrame {
+    uint32_t commandId;                 // 0: untracked (polls)
+    uint8_t length;
+    unsigned long holdoffMicros;        // Quiet time after the last RX chunk the task waits for before writing
+    uint8_t data[MAX_COMMAND_FRAME_SIZE];
+};
+
+// TX-done event: a frame has left the transmitter. The last stop bit went out
+// between busyMicros and doneMicros, the two checks around it
+struct TxDone {
+    uint32_t commandId;
+    uint8_t length;
+    unsigned long startMicros;          // Handed to the transport
+    unsigned long busyMicros;           // Last seen still transmitting
+    unsigned long doneMicros;           // First seen done
+    uint8_t data[MAX_COMMAND_FRAME_SIZE];  // The frame, for the bus capture
 };
 
-class SamsungACBridge : public MessageTarget {
+// Traffic between the RS485 task and the loop. Each counter has one writer
+struct BusIoStats {
+    bool task = false;                  // Transport serviced by the RS485 task (otherwise from loop())
+    unsigned long rxChunks = 0;
+    unsigned long rxRingFull = 0;       // Times bytes were left in the transport: the loop fell behind
+    size_t rxPeakChunks = 0;            // Most chunks the loop found waiting at once
+    unsigned long txFrames = 0;         // Frames completed (TX-done)
+    unsigned long txHeld = 0;           // Frames held at write time: the line got busy after queueing
+    unsigned long txRingFull = 0;       // Frames dropped: the task fell behind
+    unsigned long txPeakMicros = 0;     // Longest write to TX-done
+};
+
+class SamsungACBridge : public MessageTarget, public PacketHandler {
 private:
-    HardwareSerial* serial;
-    std::vector<uint8_t> rxBuffer;
-    std::map<String, DeviceState> devices;
-    std::set<String> discoveredAddresses;
+    UartTransport uart;                 // Serial2; used unless begin() is given another transport
+    ByteTransport* transport;
+    
+    // The only state shared with the RS485 task: single producer, single consumer
+    // each way (64 chunks hold about two seconds of traffic at 9600 baud)
+    SpscRing<RxChunk, 64> rxRing;
+    SpscRing<TxFrame, 4> txRing;
+    SpscRing<TxDone, 4> txDoneRing;
+    bool txActive = false;              // Task side: a frame is on the wire
+    TxDone txCurrent;
+    size_t txWritten = 0;               // Task side: bytes of the oldest TxFrame the transport took
+    bool txHolding = false;             // Task side: the oldest TxFrame waits for the line to go quiet
+    bool rxHeard = false;               // Task side: rxLastMicros is valid
+    unsigned long rxLastMicros = 0;     // Task side: when the last chunk was read
+    size_t rxChunkOffset = 0;           // Bytes of the oldest chunk already given to the decoder
+    BusIoStats ioStats;
+#ifdef ESP32
+    TaskHandle_t busTaskHandle = nullptr;
+    static void busTask(void* arg);
+#endif
+    
+    NasaDecoder decoder;
+    BusCapture capture;
+    DeviceRegistry devices;
     NasaProtocol protocol;
     CommandQueue commandQueue;
-    unsigned long lastTransmission = 0;
-    uint8_t currentSequenceNumber = 1;
+    TxScheduler txScheduler;
+    PollScheduler pollScheduler;
+    
+    // Read request picked by the poll scheduler, kept until the bus has room for it
+    uint8_t pollFrame[MAX_COMMAND_FRAME_SIZE];
+    size_t pollFrameLength = 0;
+    size_t pollMessages = 0;
+    TxDeferral pollDeferral;
     
     
     static const unsigned long DEVICE_TIMEOUT_MS_VALUE = DEVICE_TIMEOUT_MS;
-    static const unsigned long TRANSMISSION_TIMEOUT_MS = 500;
     
 public:
     SamsungACBridge();
     ~SamsungACBridge();
     
+    // Bus on the ESP32's Serial2 at the given pins
     void begin(int rxPin = 16, int txPin = 17, unsigned long baudRate = 2400);
+    
+    // Bus on any byte stream (not owned; must outlive the bridge). False if it
+    // could not be opened
+    bool begin(ByteTransport& busTransport, unsigned long baudRate);
     void loop();
     
-    // Device discovery and management
+    // Device discovery and management (string addresses are parsed once, here)
     std::vector<String> getDiscoveredDevices();
     bool isDeviceKnown(const String& address);
     bool isDeviceOnline(const String& address);
@@ -130,42 +171,67 @@ public:
     // Device state
     DeviceState getDeviceState(const String& address);
     
-    // Device control
-    bool controlDevice(const String& address, const ControlRequest& request);
+    // Measured round trips to the device (timeouts: CommandQueue::ackTimeout/confirmTimeout)
+    LinkTiming getLinkTiming(const String& address);
+    
+    // Device control. address is a device ("20.00.01") or a group target: "all"
+    // for every indoor unit, "20.<channel>.*" for the indoor units of one channel.
+    // Groups are sent as one broadcast frame and confirmed per member
+    bool controlDevice(const String& address, const ControlRequest& request, ControlResult* result = nullptr);
+    static bool parseGroupTarget(const String& target, Address& group);
+    
+    // Receive path statistics
+    const RxStats& getRxStats() const { return decoder.getStats(); }
+    
+    // Raw bus capture (streamed over TCP or downloaded via /capture)
+    BusCapture& getCapture() { return capture; }
     
     // Command queue status
     size_t getPendingCommandsCount() const { return commandQueue.getPendingCount(); }
+    size_t getPendingCommandsCount(CommandPriority priority) const { return commandQueue.getPendingCount(priority); }
+    const QueueClassStats& getQueueClassStats(CommandPriority priority) const {
+        return commandQueue.getClassStats(priority);
+    }
     bool hasActiveCommands() const { return commandQueue.getPendingCount() > 0; }
-    
-    // Handle ACK packet
-    void handleAckPacket(uint8_t packetNumber) { commandQueue.handleAck(packetNumber); }
+    size_t getCommandQueueCapacity() const { return commandQueue.capacity(); }
+    const AckStats& getAckStats() const { return commandQueue.getAckStats(); }
+    // Command by the id controlDevice returned; nullptr once finished and cleaned up
+    const QueuedCommand* getCommand(uint32_t id) const { return commandQueue.findById(id); }
+    const TxStats& getTxStats() const { return txScheduler.getStats(); }
+    const PollStats& getPollStats() const { return pollScheduler.getStats(); }
+    unsigned getPollAirtimePercent() const { return pollScheduler.getAirtimePercent(); }
+    const BusIoStats& getIoStats() const { return ioStats; }
     
     
     // MessageTarget interface implementation
-    void publishData(std::vector<uint8_t>& data) override;
-    void registerAddress(const String& address) override;
-    void setPower(const String& address, bool value) override;
-    void setRoomTemperature(const String& address, float value) override;
-    void setTargetTemperature(const String& address, float value) override;
-    void setOutdoorTemperature(const String& address, float value) override;
-    void setIndoorEvaInTemperature(const String& address, float value) override;
-    void setIndoorEvaOutTemperature(const String& address, float value) override;
-    void setMode(const String& address, Mode mode) override;
-    void setFanMode(const String& address, FanMode fanmode) override;
-    void setSwingVertical(const String& address, bool vertical) override;
-    void setSwingHorizontal(const String& address, bool horizontal) override;
-    void setPreset(const String& address, Preset preset) override;
-    void setCustomSensor(const String& address, uint16_t message_number, float value) override;
-    void setErrorCode(const String& address, int error_code) override;
-    void setOutdoorInstantaneousPower(const String& address, float value) override;
-    void setOutdoorCumulativeEnergy(const String& address, float value) override;
-    void setOutdoorCurrent(const String& address, float value) override;
-    void setOutdoorVoltage(const String& address, float value) override;
+    void publishData(const uint8_t* data, size_t length) override;
+    void registerAddress(const Address& address) override;
+    void handleAck(uint8_t packetNumber) override { commandQueue.handleAck(packetNumber, packetArrivalMs()); }
+    void handleNack(uint8_t packetNumber) override { commandQueue.handleNack(packetNumber, packetArrivalMs()); }
+    void applyDelta(const Address& address, const DeviceDelta& delta) override;
+    
+    // PacketHandler interface implementation
+    void onPacket(const Packet& packet) override {
+        if (packet.command.dataType == DataType::Response) pollScheduler.onResponse();
+        processNasaPacket(packet, this);
+    }
 
 private:
-    void processData(std::vector<uint8_t>& data);
-    void updateDeviceState(const String& address);
+    // Transport side: transport -> rxRing, txRing -> transport -> txDoneRing.
+    // Runs in the RS485 task, or from loop() where there is none; never waits
+    // for the wire
+    void pumpTransport();
+    void handleTxDone();
+    void queueFrame(const uint8_t* data, size_t length, uint32_t commandId);
+    void readBus(unsigned long now);
+    
+    // millis() when the packet being decoded arrived, not when the loop got to it
+    unsigned long packetArrivalMs() const { return millis() - (micros() - decoder.packetArrivalMicros()) / 1000; }
+    void sendNextCommand();
+    void sendNextPoll(unsigned long now);
+    void retryUnconfirmedMembers();
+    bool queueRequest(const Address& address, const QueuedRequest& request, CommandPriority priority,
+                      unsigned long deadlineMs, ControlResult* result);
+    size_t collectGroupMembers(const Address& group, uint32_t* members) const;
+    void logChanges(const DeviceEntry& device, uint32_t changed);
 };
-
-// Function declarations for protocol processing
-void processMessageSet(String source, String dest, MessageSet& message, MessageTarget* target);
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+
+// Lock-free ring for exactly one producer and one consumer, e.g. the RS485
+// task and the Arduino loop on different cores. The producer only advances
+// head and the consumer only tail, so neither side ever waits on a lock.
+// Slots are filled and read in place: claim() / publish() on the producer
+// side, peek() / release() on the consumer side. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+private:
+    T slots[Capacity];
+    std::atomic<size_t> head{0};    // Slots published (producer)
+    std::atomic<size_t> tail{0};    // Slots released (consumer)
+
+public:
+    // Producer: slot to fill, or nullptr when full
+    T* claim() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Capacity) return nullptr;
+        return &slots[h & (Capacity - 1)];
+    }
+
+    // Producer: make the claimed slot visible to the consumer
+    void publish() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: oldest published slot, or nullptr when empty
+    T* peek() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return nullptr;
+        return &slots[t & (Capacity - 1)];
+    }
+
+    // Consumer: hand the peeked slot back to the producer
+    void release() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() == Capacity; }
+    size_t capacity() const { return Capacity; }
+};
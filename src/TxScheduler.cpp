@@ -0,0 +1,118 @@
+#include "TxScheduler.h"
+#include "config.h"
+
+void TxScheduler::begin(unsigned long baudRate) {
+    // Start bit, 8 data bits, parity, stop bit
+    charMicros = baudRate ? (11UL * 1000000UL + baudRate - 1) / baudRate : 1146;
+    seenRx = false;
+    burstGapMean = 0;
+    burstGapDeviation = 0;
+    quietGapMean = 0;
+    txCollisionCounted = true;
+    stats = TxStats();
+    stats.holdoffMicros = holdoff();
+}
+
+unsigned long TxScheduler::holdoff() const {
+    unsigned long minimum = MIN_IDLE_CHARS * charMicros;
+    if (burstGapMean == 0) return minimum;
+
+    long learned = burstGapMean + 4 * burstGapDeviation;
+    if (learned < (long)minimum) return minimum;
+    if (learned > (long)(BURST_GAP_LIMIT_MS * 1000)) return BURST_GAP_LIMIT_MS * 1000;
+    return (unsigned long)learned;
+}
+
+void TxScheduler::learnGap(unsigned long gapMicros) {
+    long gap = (long)gapMicros;
+
+    if (gapMicros < BURST_GAP_LIMIT_MS * 1000) {
+        if (burstGapMean == 0) {
+            burstGapMean = gap;
+            burstGapDeviation = gap / 2;
+        } else {
+            long error = gap - burstGapMean;
+            burstGapMean += error / 8;
+            burstGapDeviation += ((error < 0 ? -error : error) - burstGapDeviation) / 4;
+        }
+        stats.holdoffMicros = holdoff();
+    } else {
+        quietGapMean = quietGapMean == 0 ? gap : quietGapMean + (gap - quietGapMean) / 8;
+        stats.quietGapMicros = (unsigned long)quietGapMean;
+    }
+}
+
+void TxScheduler::onRxBytes(size_t count, unsigned long nowMicros) {
+    if (count == 0) return;
+
+    // The batch started on the wire count characters before we read it
+    unsigned long batchStart = nowMicros - count * charMicros;
+
+    // First traffic after one of our frames: did it overlap the frame?
+    if (!txCollisionCounted) {
+        txCollisionCounted = true;
+        if ((long)(batchStart - txEndMicros) < 0 && (long)(nowMicros - txStartMicros) > 0) {
+            stats.estimatedCollisions++;
+            DEBUG_PRINTLN("TX: bus traffic overlapped our frame (collision)");
+        }
+    }
+
+    if (seenRx) {
+        long gap = (long)(batchStart - lastRxMicros);
+        if (gap >= (long)(MIN_IDLE_CHARS * charMicros)) {
+            learnGap((unsigned long)gap);
+        }
+    }
+
+    lastRxMicros = nowMicros;
+    seenRx = true;
+}
+
+bool TxScheduler::canSend(size_t frameBytes, unsigned long nowMicros, TxDeferral& deferral) {
+    bool fits = true;
+
+    if (seenRx) {
+        // Negative while our own previous frame is still on the wire
+        long idle = (long)(nowMicros - lastRxMicros);
+        unsigned long required = holdoff();
+
+        if (idle < (long)required) {
+            fits = false;
+        } else if (quietGapMean != 0 && idle < quietGapMean &&
+                   idle + (long)frameMicros(frameBytes) > quietGapMean) {
+            // The next burst is due before the frame would be finished; once
+            // its predicted start has passed the bus counts as free. A frame
+            // that waited long enough goes out anyway
+            fits = deferral.active && nowMicros - deferral.sinceMicros >= MAX_DEFER_MS * 1000;
+            if (fits) stats.forcedSends++;
+        }
+    }
+
+    if (!fits && !deferral.active) {
+        deferral.active = true;
+        deferral.sinceMicros = nowMicros;
+        stats.deferredSends++;
+    }
+    return fits;
+}
+
+void TxScheduler::onSend(size_t frameBytes, unsigned long nowMicros, TxDeferral& deferral) {
+    stats.framesSent++;
+    deferral.active = false;
+
+    txStartMicros = nowMicros;
+    txEndMicros = nowMicros + frameMicros(frameBytes);
+    txCollisionCounted = false;
+
+    // Our own frame is line activity too: the gap to the answer is learned as a burst gap
+    lastRxMicros = txEndMicros;
+    seenRx = true;
+}
+
+void TxScheduler::onTxDone(unsigned long startMicros, unsigned long endMicros) {
+    txStartMicros = startMicros;
+    txEndMicros = endMicros;
+    
+    // Replaces the estimate from onSend, unless an answer was already heard after it
+    if (!txCollisionCounted || (long)(endMicros - lastRxMicros) > 0) lastRxMicros = endMicros;
+}
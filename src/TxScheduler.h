@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Transmit scheduler counters
+struct TxStats {
+    unsigned long framesSent = 0;
+    unsigned long deferredSends = 0;        // Frames that had to wait for a gap
+    unsigned long forcedSends = 0;          // Sent after MAX_DEFER_MS without a fitting gap
+    unsigned long estimatedCollisions = 0;  // Other traffic seen while our frame was on the wire
+    unsigned long holdoffMicros = 0;        // Current post-frame silence required before sending
+    unsigned long quietGapMicros = 0;       // Learned length of the gaps between bursts
+};
+
+// Deferral state of one pending frame, owned by whoever holds the frame
+struct TxDeferral {
+    bool active = false;
+    unsigned long sinceMicros = 0;
+};
+
+// Decides when the bus is free enough to transmit.
+//
+// Line activity comes from RX byte timestamps. Bytes reach us in batches (UART
+// FIFO, RS485 task reads), so each batch is assumed to have ended when it
+// was read and to have started count character times earlier; the silence
+// before it is an inter-frame gap. Gaps are learned in two classes:
+//   - burst gaps (< BURST_GAP_LIMIT_MS): request/ACK turnaround and frames sent
+//     back to back; after a frame the line must stay quiet for their mean plus
+//     four deviations before we may assume nobody is about to answer
+//   - quiet gaps: the idle time between bursts; the next burst is predicted
+//     their mean after the last traffic. A frame is held back only if that
+//     start falls within its airtime; idle time beyond it counts as free
+class TxScheduler {
+public:
+    void begin(unsigned long baudRate);
+
+    // count bytes were read from the UART at nowMicros
+    void onRxBytes(size_t count, unsigned long nowMicros);
+
+    // True if a frame of frameBytes fits into the current gap. deferral
+    // belongs to that frame: it records how long the frame has been waiting
+    bool canSend(size_t frameBytes, unsigned long nowMicros, TxDeferral& deferral);
+
+    // A frame of frameBytes was queued for transmission at nowMicros; until
+    // onTxDone() its airtime is estimated from the baud rate
+    void onSend(size_t frameBytes, unsigned long nowMicros, TxDeferral& deferral);
+    
+    // The transport reported that frame on the wire from startMicros until its
+    // last stop bit at endMicros: the line turned around then
+    void onTxDone(unsigned long startMicros, unsigned long endMicros);
+
+    unsigned long frameMicros(size_t bytes) const { return bytes * charMicros; }
+    const TxStats& getStats() const { return stats; }
+
+private:
+    static const unsigned long MIN_IDLE_CHARS = 4;          // End-of-frame silence
+    static const unsigned long BURST_GAP_LIMIT_MS = 100;
+    static const unsigned long MAX_DEFER_MS = 1000;         // Never starve a frame longer than this
+
+    unsigned long charMicros = 1146;                         // 11 bits (8E1) at 9600 baud
+    unsigned long lastRxMicros = 0;
+    bool seenRx = false;
+
+    // EWMA estimators in microseconds (gain 1/8 for the mean, 1/4 for the deviation)
+    long burstGapMean = 0;
+    long burstGapDeviation = 0;
+    long quietGapMean = 0;
+
+    unsigned long txStartMicros = 0;
+    unsigned long txEndMicros = 0;
+    bool txCollisionCounted = true;
+
+    TxStats stats;
+
+    void learnGap(unsigned long gapMicros);
+    unsigned long holdoff() const;
+};
@@ -0,0 +1,30 @@
+#include "UartTransport.h"
+#include "config.h"
+#ifdef ESP32
+#include <driver/uart.h>
+#endif
+
+bool UartTransport::begin(unsigned long baudRate) {
+    // Samsung AC uses Even parity
+    serial.begin(baudRate, SERIAL_8E1, rxPin, txPin);
+    serial.setTimeout(100);
+    
+#ifdef ESP32
+    if (dePin >= 0) {
+        serial.setPins(rxPin, txPin, -1, dePin);  // RTS drives DE
+        serial.setMode(UART_MODE_RS485_HALF_DUPLEX);
+    }
+#endif
+    
+    DEBUG_PRINTF("UART initialized on pins RX:%d TX:%d DE:%d at %lu baud\n", rxPin, txPin, dePin, baudRate);
+    return true;
+}
+
+bool UartTransport::txDone() {
+#ifdef ESP32
+    // Zero ticks: a status query, not a wait
+    return uart_wait_tx_done((uart_port_t)uartNumber, 0) == ESP_OK;
+#else
+    return serial.txDone();
+#endif
+}
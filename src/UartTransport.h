@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include "ByteTransport.h"
+
+// ESP32 hardware UART on the given pins. With a driver-enable pin the UART
+// runs in RS485 half-duplex mode: the peripheral raises DE for each frame and
+// drops it right after the last stop bit, so turnaround never waits on software
+class UartTransport : public ByteTransport {
+private:
+    HardwareSerial& serial;
+    uint8_t uartNumber;                 // ESP-IDF port behind serial, for TX-done
+    int rxPin;
+    int txPin;
+    int dePin = -1;
+    
+public:
+    UartTransport(HardwareSerial& serial, uint8_t uartNumber, int rxPin = 16, int txPin = 17)
+        : serial(serial), uartNumber(uartNumber), rxPin(rxPin), txPin(txPin) {}
+    
+    // Take effect at the next begin(); dePin -1 when the transceiver switches
+    // direction by itself
+    void setPins(int rx, int tx, int de = -1) {
+        rxPin = rx;
+        txPin = tx;
+        dePin = de;
+    }
+    
+    bool begin(unsigned long baudRate) override;
+    int available() override { return serial.available(); }
+    size_t read(uint8_t* buffer, size_t length) override { return serial.read(buffer, length); }
+    
+    // The bridge writes one frame at a time after txDone(); a frame fits the
+    // 128-byte hardware FIFO, so this returns without waiting for the wire
+    size_t write(const uint8_t* data, size_t length) override { return serial.write(data, length); }
+    bool txDone() override;
+};
@@ -5,8 +5,10 @@
 #include "DebugLog.h"
 #include "DebugWebSocket.h"
 
-// Debug output control
+// Debug output control (host builds pass -DDEBUG_ENABLED=0)
+#ifndef DEBUG_ENABLED
 #define DEBUG_ENABLED 1
+#endif
 
 #if DEBUG_ENABLED
   #define DEBUG_PRINT(x) do { Serial.print(x); DebugLog::getInstance().addLine(String(x)); } while(0)
@@ -9,6 +9,8 @@
 #include "user_config.h"
 #include "NasaProtocol.h"
 #include "SamsungACBridge.h"
+#include "MessageCatalog.h"
+#include "BusCapture.h"
 
 // Web server on port 80
 WebServer server(80);
@@ -16,10 +18,35 @@ WebServer server(80);
 // Samsung AC Bridge instance
 SamsungACBridge bridge;
 
+// Raw bus capture stream (one client at a time)
+WiFiServer captureServer(CAPTURE_TCP_PORT);
+WiFiClient captureClient;
+static bool captureStreaming = false;
+
+// Retry-After for a full command queue: about one ACK cycle
+static const int COMMAND_QUEUE_RETRY_AFTER_S = 1;
+// GET /command?wait= requests are parked, not served in the handler: the
+// connection is kept and answered from loop() once the command finishes or
+// the wait is over. Waits go up to the longest confirmation timeout; a
+// command still running is answered with Retry-After and polled again
+static const unsigned long COMMAND_WAIT_MAX_MS = CommandQueue::CONFIRM_TIMEOUT_MAX_MS;
+static const int COMMAND_POLL_RETRY_AFTER_S = 1;
+static const size_t COMMAND_WAIT_SLOTS = 4;         // Parked requests; more are answered at once
+
+struct CommandWait {
+    bool inUse = false;
+    uint32_t id = 0;
+    unsigned long deadline = 0;
+    WiFiClient client;
+};
+static CommandWait commandWaits[COMMAND_WAIT_SLOTS];
+
 // UDP client for status broadcasting
+
 #if UDP_ENABLED
 WiFiUDP udp;
 static unsigned long lastUdpBroadcast = 0;
+static const size_t UDP_DEVICES_PER_PACKET = 8;   // Keeps each datagram under a 1500 byte MTU
 #endif
 
 // Forward declarations
@@ -28,6 +55,9 @@ void setupRoutes();
 void handleGetDevices();
 void handleGetDevice();
 void handleControlDevice();
+void handleGetCommand();
+void handleCommandWaits();
+String commandStatusJson(const QueuedCommand& cmd);
 void handleGetSensors();
 void handleUpdatePage();
 void handleUpdateUpload();
@@ -35,6 +65,9 @@ void handleUpdateFile();
 void handleRS485Test();
 void handleWiFiInfo();
 void handleDebugStream();
+void handleGetStats();
+void handleCaptureDownload();
+void handleCaptureClient();
 #if UDP_ENABLED
 void sendUdpStatusUpdate();
 #endif
@@ -104,6 +137,10 @@ void setup() {
     server.begin();
     DEBUG_PRINTLN("HTTP server started");
     
+    // Start bus capture stream server
+    captureServer.begin();
+    DEBUG_PRINTF("Capture stream on TCP port %d\n", CAPTURE_TCP_PORT);
+    
 }
 
 void loop() {
@@ -112,6 +149,8 @@ void loop() {
     server.handleClient();
     ArduinoOTA.handle();
     bridge.loop();
+    handleCommandWaits();
+    handleCaptureClient();
     M5.update();  // Keep M5 alive
     
 #if UDP_ENABLED
@@ -225,6 +264,8 @@ void setupRoutes() {
             html += "<a href='/devices'>Devices (JSON)</a>";
             html += "<a href='/wifi'>WiFi Info (JSON)</a>";
             html += "<a href='/queue'>Queue Status (JSON)</a>";
+            html += "<a href='/stats'>RS485 Statistics (JSON)</a>";
+            html += "<a href='/capture'>Bus Capture (download)</a>";
             html += "<a href='/update'>Firmware Update</a>";
             html += "</div>";
             html += "</body></html>";
@@ -256,6 +297,9 @@ void setupRoutes() {
     // Control device
     server.on("/device/control", HTTP_POST, handleControlDevice);
     
+    // Command status (optionally waits for it to finish)
+    server.on("/command", HTTP_GET, handleGetCommand);
+    
     // Get device sensors
     server.on("/device/sensors", HTTP_GET, handleGetSensors);
     
@@ -271,9 +315,30 @@ void setupRoutes() {
     
     // Command queue status endpoint
     server.on("/queue", HTTP_GET, []() {
-        StaticJsonDocument<200> doc;
+        StaticJsonDocument<1024> doc;
         doc["pending_commands"] = bridge.getPendingCommandsCount();
         doc["has_active_commands"] = bridge.hasActiveCommands();
+        doc["capacity"] = bridge.getCommandQueueCapacity();
+        
+        JsonObject classes = doc.createNestedObject("classes");
+        for (int i = 0; i < COMMAND_PRIORITY_COUNT; i++) {
+            CommandPriority priority = (CommandPriority)i;
+            const QueueClassStats& stats = bridge.getQueueClassStats(priority);
+            JsonObject cls = classes.createNestedObject(commandPriorityToString(priority));
+            cls["pending"] = bridge.getPendingCommandsCount(priority);
+            cls["sent"] = stats.sent;
+            cls["expired"] = stats.expired;
+            cls["avg_wait_ms"] = stats.sent ? stats.totalWaitMs / stats.sent : 0;
+            cls["max_wait_ms"] = stats.maxWaitMs;
+        }
+        
+        const AckStats& ack = bridge.getAckStats();
+        JsonObject acks = doc.createNestedObject("acks");
+        acks["matched"] = ack.acks;
+        acks["duplicate"] = ack.duplicateAcks;
+        acks["stale"] = ack.staleAcks;
+        acks["unknown"] = ack.unknownAcks;
+        acks["nacks"] = ack.nacks;
         
         String response;
         serializeJsonPretty(doc, response);
@@ -282,6 +347,22 @@ void setupRoutes() {
         server.send(200, "application/json", response);
     });
     
+    // RS485 receive statistics endpoint
+    server.on("/stats", HTTP_GET, handleGetStats);
+    
+    // Raw bus capture: start/stop buffering and download what was captured
+    server.on("/capture", HTTP_GET, handleCaptureDownload);
+    server.on("/capture/start", HTTP_POST, []() {
+        bridge.getCapture().start();
+        server.sendHeader("Access-Control-Allow-Origin", "*");
+        server.send(200, "application/json", "{\"capture\":\"started\"}");
+    });
+    server.on("/capture/stop", HTTP_POST, []() {
+        bridge.getCapture().stop();
+        server.sendHeader("Access-Control-Allow-Origin", "*");
+        server.send(200, "application/json", "{\"capture\":\"stopped\"}");
+    });
+    
     // Debug console endpoint
     server.on("/debug", HTTP_GET, []() {
         String html = R"(<!DOCTYPE html>
@@ -444,11 +525,13 @@ void setupRoutes() {
 }
 
 void handleGetDevices() {
-    // Smaller buffer for device list
-    StaticJsonDocument<512> doc;
+    auto deviceList = bridge.getDiscoveredDevices();
+    
+    // Sized for the actual device count - large sites overflowed a fixed 512 byte document
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(deviceList.size()) +
+                            deviceList.size() * (JSON_OBJECT_SIZE(3) + 32));
     JsonArray devices = doc.createNestedArray("devices");
     
-    auto deviceList = bridge.getDiscoveredDevices();
     for (const auto& address : deviceList) {
         JsonObject device = devices.createNestedObject();
         device["address"] = address;
@@ -474,7 +557,7 @@ void handleGetDevice() {
     String address = server.arg("address");
     
     // Reduced JSON buffer size
-    StaticJsonDocument<512> doc;
+    StaticJsonDocument<768> doc;
     
     if (!bridge.isDeviceKnown(address)) {
         doc["error"] = "Device not found";
@@ -499,8 +582,21 @@ void handleGetDevice() {
     doc["swing_horizontal"] = state.swingHorizontal;
     doc["preset"] = presetToString(state.preset);
     
+    // Command round trips as measured by the queue, and the timeouts it uses
+    LinkTiming link = bridge.getLinkTiming(address);
+    JsonObject linkObj = doc.createNestedObject("link");
+    linkObj["ack_samples"] = link.ack.samples();
+    linkObj["ack_rtt_ms"] = link.ack.smoothed();
+    linkObj["ack_rtt_dev_ms"] = link.ack.deviation();
+    linkObj["ack_timeout_ms"] = CommandQueue::ackTimeout(&link);
+    linkObj["confirm_samples"] = link.confirm.samples();
+    linkObj["confirm_ms"] = link.confirm.smoothed();
+    linkObj["confirm_dev_ms"] = link.confirm.deviation();
+    linkObj["confirm_timeout_ms"] = CommandQueue::confirmTimeout(&link);
+    linkObj["nacks"] = link.nacks;
+    
     String response;
-    response.reserve(768); // Pre-allocate to reduce fragmentation
+    response.reserve(1024); // Pre-allocate to reduce fragmentation
     serializeJsonPretty(doc, response);
     
     server.sendHeader("Access-Control-Allow-Origin", "*");
@@ -532,8 +628,10 @@ void handleControlDevice() {
     }
     
     String address = doc["address"];
+    Address group;
+    bool isGroup = SamsungACBridge::parseGroupTarget(address, group);
     
-    if (!bridge.isDeviceKnown(address)) {
+    if (!isGroup && !bridge.isDeviceKnown(address)) {
         server.sendHeader("Access-Control-Allow-Origin", "*");
         server.send(404, "application/json", "{\"error\":\"Device not found\"}");
         return;
@@ -582,22 +680,43 @@ void handleControlDevice() {
         request.hasPreset = true;
     }
     
+    if (doc.containsKey("priority")) {
+        if (!commandPriorityFromString(doc["priority"].as<String>(), request.priority)) {
+            server.sendHeader("Access-Control-Allow-Origin", "*");
+            server.send(400, "application/json", "{\"error\":\"Invalid priority\"}");
+            return;
+        }
+    }
+    
+    if (doc.containsKey("deadline_ms")) {
+        request.deadlineMs = doc["deadline_ms"].as<unsigned long>();
+    }
+    
     // Send control request
-    bool success = bridge.controlDevice(address, request);
+    ControlResult result;
+    bool success = bridge.controlDevice(address, request, &result);
+    bool merged = result.merged;
     
     if (success) {
-        DEBUG_PRINTF("HTTP: Command queued for %s\n", address.c_str());
+        DEBUG_PRINTF("HTTP: Command %s for %s\n", merged ? "merged" : "queued", address.c_str());
     } else {
         DEBUG_PRINTF("HTTP: Failed to queue command for %s\n", address.c_str());
     }
     
-    StaticJsonDocument<200> responseDoc;
+    StaticJsonDocument<256> responseDoc;
     responseDoc["success"] = success;
     responseDoc["queued"] = success;
+    responseDoc["merged"] = merged;
+    if (success) responseDoc["command_id"] = result.commandId;
     responseDoc["pending_commands"] = bridge.getPendingCommandsCount();
-    
-    if (!success) {
-        responseDoc["error"] = "Failed to queue command";
+    if (isGroup) responseDoc["members"] = result.members;
+    
+    if (result.queueFull) {
+        responseDoc["error"] = "Command queue full";
+    } else if (!success) {
+        responseDoc["error"] = isGroup ? "No devices in group" : "Failed to queue command";
+    } else if (merged) {
+        responseDoc["message"] = "Command merged into pending request";
     } else {
         responseDoc["message"] = "Command queued for execution";
     }
@@ -606,9 +725,112 @@ void handleControlDevice() {
     serializeJsonPretty(responseDoc, response);
     
     server.sendHeader("Access-Control-Allow-Origin", "*");
+    if (result.queueFull) {
+        // Backpressure: the queue frees up as commands are ACKed or time out
+        server.sendHeader("Retry-After", String(COMMAND_QUEUE_RETRY_AFTER_S));
+        server.send(429, "application/json", response);
+        return;
+    }
     server.send(success ? 200 : 500, "application/json", response);
 }
 
+void handleGetCommand() {
+    if (!server.hasArg("id")) {
+        server.sendHeader("Access-Control-Allow-Origin", "*");
+        server.send(400, "application/json", "{\"error\":\"Missing id parameter\"}");
+        return;
+    }
+    
+    uint32_t id = strtoul(server.arg("id").c_str(), nullptr, 10);
+    unsigned long waitMs = 0;
+    if (server.hasArg("wait")) {
+        waitMs = strtoul(server.arg("wait").c_str(), nullptr, 10);
+        if (waitMs > COMMAND_WAIT_MAX_MS) waitMs = COMMAND_WAIT_MAX_MS;
+    }
+    
+    const QueuedCommand* cmd = bridge.getCommand(id);
+    if (!cmd) {
+        server.sendHeader("Access-Control-Allow-Origin", "*");
+        server.send(404, "application/json", "{\"error\":\"Unknown or expired command id\"}");
+        return;
+    }
+    
+    // Long-poll: park the connection without answering; handleCommandWaits()
+    // responds on it. The WebServer drops its own reference after its close
+    // wait (2 s, no other client is served meanwhile), ours keeps the socket open
+    if (waitMs > 0 && !CommandQueue::isFinished(*cmd)) {
+        for (auto& wait : commandWaits) {
+            if (wait.inUse) continue;
+            wait.inUse = true;
+            wait.id = id;
+            wait.deadline = millis() + waitMs;
+            wait.client = server.client();
+            return;
+        }
+    }
+    
+    String response = commandStatusJson(*cmd);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    if (!CommandQueue::isFinished(*cmd)) server.sendHeader("Retry-After", String(COMMAND_POLL_RETRY_AFTER_S));
+    server.send(200, "application/json", response);
+}
+
+void handleCommandWaits() {
+    for (auto& wait : commandWaits) {
+        if (!wait.inUse) continue;
+        if (!wait.client.connected()) {
+            wait.client.stop();
+            wait.inUse = false;
+            continue;
+        }
+        
+        const QueuedCommand* cmd = bridge.getCommand(wait.id);
+        bool finished = cmd && CommandQueue::isFinished(*cmd);
+        if (cmd && !finished && (long)(millis() - wait.deadline) < 0) continue;
+        
+        // The request was read by the WebServer; the response is written here
+        String body = cmd ? commandStatusJson(*cmd) : String("{\"error\":\"Unknown or expired command id\"}");
+        String head = cmd ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n";
+        head += "Content-Type: application/json\r\n";
+        head += "Access-Control-Allow-Origin: *\r\n";
+        if (cmd && !finished) head += "Retry-After: " + String(COMMAND_POLL_RETRY_AFTER_S) + "\r\n";
+        head += "Content-Length: " + String(body.length()) + "\r\n";
+        head += "Connection: close\r\n\r\n";
+        wait.client.print(head);
+        wait.client.print(body);
+        wait.client.stop();
+        wait.inUse = false;
+    }
+}
+
+String commandStatusJson(const QueuedCommand& cmd) {
+    // Timestamps are millis() uptime, null until the step happened
+    StaticJsonDocument<512> doc;
+    doc["id"] = cmd.id;
+    doc["address"] = cmd.targetAddress.toString();
+    doc["state"] = commandStateToString(cmd.state);
+    doc["finished"] = CommandQueue::isFinished(cmd);
+    doc["confirmed"] = cmd.confirmed;
+    doc["priority"] = commandPriorityToString(cmd.priority);
+    doc["attempts"] = cmd.retryCount;
+    doc["merged_requests"] = cmd.mergedRequests;
+    if (cmd.broadcast) doc["members"] = cmd.memberCount;
+    doc["queued_at"] = cmd.queuedTime;
+    if (cmd.retryCount > 0) doc["sent_at"] = cmd.firstSentTime;
+    else doc["sent_at"] = nullptr;
+    if (cmd.ackTime) doc["acked_at"] = cmd.ackTime;
+    else doc["acked_at"] = nullptr;
+    if (cmd.confirmed) doc["confirmed_at"] = cmd.finishedTime;
+    else doc["confirmed_at"] = nullptr;
+    if (CommandQueue::isFinished(cmd)) doc["finished_at"] = cmd.finishedTime;
+    else doc["finished_at"] = nullptr;
+    doc["now"] = millis();
+    
+    String response;
+    serializeJsonPretty(doc, response);
+    return response;
+}
+
 void handleGetSensors() {
     if (!server.hasArg("address")) {
         server.sendHeader("Access-Control-Allow-Origin", "*");
@@ -624,8 +846,8 @@ void handleGetSensors() {
         return;
     }
     
-    // Smaller buffer for sensors
-    StaticJsonDocument<400> doc;
+    // Room for the fixed fields plus every catalogued message
+    StaticJsonDocument<1536> doc;
     
     DeviceState state = bridge.getDeviceState(address);
     
@@ -641,6 +863,15 @@ void handleGetSensors() {
     doc["current"] = state.current;
     doc["voltage"] = state.voltage;
     
+    // Every catalogued message seen from this device, scaled, by JSON name
+    JsonObject messages = doc.createNestedObject("messages");
+    for (const auto& sensor : state.customSensors) {
+        const MessageInfo* info = findMessageInfo((MessageNumber)sensor.first);
+        if (info) {
+            messages[info->name] = info->scale((long)sensor.second);
+        }
+    }
+    
     String response;
     serializeJsonPretty(doc, response);
     
@@ -648,6 +879,130 @@ void handleGetSensors() {
     server.send(200, "application/json", response);
 }
 
+void handleGetStats() {
+    StaticJsonDocument<1024> doc;
+    
+    const RxStats& rx = bridge.getRxStats();
+    JsonObject rxObj = doc.createNestedObject("rx");
+    rxObj["bytes_received"] = rx.bytesReceived;
+    rxObj["frames_decoded"] = rx.framesDecoded;
+    rxObj["decode_errors"] = rx.decodeErrors;
+    rxObj["frames_per_second"] = rx.framesPerSecond;
+    rxObj["peak_packet_bytes"] = rx.peakPacketBytes;
+    rxObj["resync_events"] = rx.resyncEvents;
+    
+    JsonObject discarded = rxObj.createNestedObject("bytes_discarded");
+    for (int i = 1; i < DECODE_RESULT_COUNT; i++) {
+        discarded[decodeResultToString((DecodeResult)i)] = rx.bytesDiscarded[i];
+    }
+    
+    const TxStats& tx = bridge.getTxStats();
+    JsonObject txObj = doc.createNestedObject("tx");
+    txObj["frames_sent"] = tx.framesSent;
+    txObj["deferred_sends"] = tx.deferredSends;
+    txObj["forced_sends"] = tx.forcedSends;
+    txObj["estimated_collisions"] = tx.estimatedCollisions;
+    txObj["holdoff_us"] = tx.holdoffMicros;
+    txObj["quiet_gap_us"] = tx.quietGapMicros;
+    
+    // Hand-off between the RS485 task and the loop; non-zero ring_full counts mean a side fell behind
+    const BusIoStats& io = bridge.getIoStats();
+    JsonObject ioObj = doc.createNestedObject("io");
+    ioObj["rs485_task"] = io.task;
+    ioObj["rx_chunks"] = io.rxChunks;
+    ioObj["rx_ring_full"] = io.rxRingFull;
+    ioObj["rx_peak_chunks"] = io.rxPeakChunks;
+    ioObj["tx_frames"] = io.txFrames;
+    ioObj["tx_ring_full"] = io.txRingFull;
+    ioObj["tx_held"] = io.txHeld;
+    ioObj["tx_peak_us"] = io.txPeakMicros;
+    
+    const PollStats& poll = bridge.getPollStats();
+    JsonObject pollObj = doc.createNestedObject("poll");
+    pollObj["airtime_budget_percent"] = bridge.getPollAirtimePercent();
+    pollObj["requests_sent"] = poll.requestsSent;
+    pollObj["messages_requested"] = poll.messagesRequested;
+    pollObj["responses"] = poll.responses;
+    pollObj["budget_deferrals"] = poll.budgetDeferrals;
+    pollObj["airtime_ms"] = poll.airtimeMicros / 1000;
+    
+    BusCapture& capture = bridge.getCapture();
+    JsonObject captureObj = doc.createNestedObject("capture");
+    captureObj["enabled"] = capture.isEnabled();
+    captureObj["streaming"] = captureStreaming;
+    captureObj["records"] = capture.getRecordCount();
+    captureObj["dropped_records"] = capture.getDroppedCount();
+    captureObj["pending_bytes"] = capture.pending();
+    
+    String response;
+    serializeJsonPretty(doc, response);
+    
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "application/json", response);
+}
+
+void handleCaptureDownload() {
+    BusCapture& capture = bridge.getCapture();
+    
+    if (captureStreaming) {
+        server.sendHeader("Access-Control-Allow-Origin", "*");
+        server.send(409, "application/json", "{\"error\":\"Capture is being streamed over TCP\"}");
+        return;
+    }
+    
+    // Send everything buffered so far; records are appended whole, so this
+    // snapshot never ends mid-record
+    size_t length = capture.pending();
+    uint8_t chunk[512];
+    writeCaptureFileHeader(chunk);
+    
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.sendHeader("Content-Disposition", "attachment; filename=\"nasa-capture.bin\"");
+    server.setContentLength(CAPTURE_FILE_HEADER_SIZE + length);
+    server.send(200, "application/octet-stream", "");
+    server.sendContent((const char*)chunk, CAPTURE_FILE_HEADER_SIZE);
+    
+    while (length > 0) {
+        size_t n = capture.read(chunk, length < sizeof(chunk) ? length : sizeof(chunk));
+        server.sendContent((const char*)chunk, n);
+        length -= n;
+    }
+}
+
+void handleCaptureClient() {
+    BusCapture& capture = bridge.getCapture();
+    
+    if (captureServer.hasClient()) {
+        // A new connection replaces the current one
+        if (captureClient) captureClient.stop();
+        captureClient = captureServer.available();
+        
+        uint8_t header[CAPTURE_FILE_HEADER_SIZE];
+        writeCaptureFileHeader(header);
+        captureClient.write(header, sizeof(header));
+        capture.start();
+        captureStreaming = true;
+        DEBUG_PRINTF("Capture client connected: %s\n", captureClient.remoteIP().toString().c_str());
+    }
+    
+    if (!captureStreaming) return;
+    
+    if (!captureClient.connected()) {
+        captureClient.stop();
+        capture.stop();
+        captureStreaming = false;
+        DEBUG_PRINTLN("Capture client disconnected");
+        return;
+    }
+    
+    // Forward a bounded chunk per loop pass so RS485 handling is not starved
+    uint8_t chunk[512];
+    size_t n = capture.read(chunk, sizeof(chunk));
+    if (n > 0) {
+        captureClient.write(chunk, n);
+    }
+}
+
 void handleUpdatePage() {
     String html = R"(
 <!DOCTYPE html>
@@ -926,47 +1281,67 @@ void sendUdpStatusUpdate() {
     auto deviceList = bridge.getDiscoveredDevices();
     if (deviceList.empty()) return;
     
-    // Create compact JSON status update
-    StaticJsonDocument<768> doc;
-    JsonArray devices = doc.createNestedArray("devices");
-    
+    std::vector<String> online;
     for (const auto& address : deviceList) {
-        if (!bridge.isDeviceOnline(address)) continue;
+        if (bridge.isDeviceOnline(address)) online.push_back(address);
+    }
+    
+    // Large sites are split over several datagrams instead of being truncated
+    size_t parts = (online.size() + UDP_DEVICES_PER_PACKET - 1) / UDP_DEVICES_PER_PACKET;
+    if (parts == 0) parts = 1;
+    
+    for (size_t part = 0; part < parts; part++) {
+        // Create compact JSON status update
+        DynamicJsonDocument doc(2048);
+        JsonArray devices = doc.createNestedArray("devices");
         
-        DeviceState state = bridge.getDeviceState(address);
-        JsonObject device = devices.createNestedObject();
+        size_t first = part * UDP_DEVICES_PER_PACKET;
+        size_t last = std::min(first + UDP_DEVICES_PER_PACKET, online.size());
+        for (size_t i = first; i < last; i++) {
+            const String& address = online[i];
+            DeviceState state = bridge.getDeviceState(address);
+            JsonObject device = devices.createNestedObject();
+            
+            device["addr"] = address;
+            device["type"] = bridge.getDeviceType(address);
+            device["power"] = state.power;
+            device["mode"] = (int)state.mode;
+            device["temp_target"] = round(state.targetTemperature * 10.0) / 10.0;
+            device["temp_room"] = round(state.roomTemperature * 10.0) / 10.0;
+            device["fan"] = (int)state.fanMode;
+            device["preset"] = presetToString(state.preset);
+            
+            // Add sensor data for outdoor units
+            if (address.startsWith("10.")) {
+                device["temp_outdoor"] = round(state.outdoorTemperature * 10.0) / 10.0;
+                device["power_instant"] = state.instantaneousPower;
+                device["current"] = state.current;
+                device["voltage"] = state.voltage;
+            }
+        }
         
-        device["addr"] = address;
-        device["type"] = bridge.getDeviceType(address);
-        device["power"] = state.power;
-        device["mode"] = (int)state.mode;
-        device["temp_target"] = round(state.targetTemperature * 10.0) / 10.0;
-        device["temp_room"] = round(state.roomTemperature * 10.0) / 10.0;
-        device["fan"] = (int)state.fanMode;
-        device["preset"] = presetToString(state.preset);
+        // Add timestamp
+        doc["timestamp"] = millis() / 1000;
+        if (parts > 1) {
+            doc["part"] = part + 1;
+            doc["parts"] = parts;
+        }
         
-        // Add sensor data for outdoor units
-        if (address.startsWith("10.")) {
-            device["temp_outdoor"] = round(state.outdoorTemperature * 10.0) / 10.0;
-            device["power_instant"] = state.instantaneousPower;
-            device["current"] = state.current;
-            device["voltage"] = state.voltage;
+        if (doc.overflowed()) {
+            DEBUG_PRINTLN("UDP status document overflowed");
         }
+        
+        String jsonString;
+        serializeJson(doc, jsonString);
+        
+        // Send UDP packet
+        udp.beginPacket(UDP_TARGET_IP, UDP_TARGET_PORT);
+        udp.write((const uint8_t*)jsonString.c_str(), jsonString.length());
+        bool success = udp.endPacket();
+        
+        DEBUG_PRINTF("UDP broadcast sent to %s:%d, success: %s, size: %d bytes\n", 
+                     UDP_TARGET_IP, UDP_TARGET_PORT, success ? "YES" : "NO", jsonString.length());
     }
-    
-    // Add timestamp
-    doc["timestamp"] = millis() / 1000;
-    
-    String jsonString;
-    serializeJson(doc, jsonString);
-    
-    // Send UDP packet
-    udp.beginPacket(UDP_TARGET_IP, UDP_TARGET_PORT);
-    udp.write((const uint8_t*)jsonString.c_str(), jsonString.length());
-    bool success = udp.endPacket();
-    
-    DEBUG_PRINTF("UDP broadcast sent to %s:%d, success: %s, size: %d bytes\n", 
-                 UDP_TARGET_IP, UDP_TARGET_PORT, success ? "YES" : "NO", jsonString.length());
 }
 #endif
 